@@ -1,7 +1,9 @@
 #ifndef INCLUDE_SIPHASHXN_H
 #define INCLUDE_SIPHASHXN_H
 
-#ifdef __AVX2__
+// a variant built for a target pragma, which leaves __AVX2__ and the like
+// undefined, names its lanes in NSIPHASH instead
+#if defined(__AVX2__) || NSIPHASH == 8 || NSIPHASH == 16
 
 #include <immintrin.h> // for _mm256_* intrinsics
 
@@ -47,12 +49,109 @@
         v6 = ROT32(v6);   \
     } while (0)
 
+#if defined(__AVX512F__) || NSIPHASH == 16
+
+// 16 way variant, two interleaved sets of 8x64 bit lanes. AVX-512 has a
+// native 64 bit rotate so no shift/or pairs or byte shuffles are needed.
+#define ADDX16(a, b) _mm512_add_epi64(a, b)
+#define XORX16(a, b) _mm512_xor_si512(a, b)
+#define ROTLX16(x, b) _mm512_rol_epi64(x, b)
+
+#define SIPROUNDX16                 \
+    do {                            \
+        v0 = ADDX16(v0, v1);        \
+        v4 = ADDX16(v4, v5);        \
+        v2 = ADDX16(v2, v3);        \
+        v6 = ADDX16(v6, v7);        \
+        v1 = ROTLX16(v1, 13);       \
+        v5 = ROTLX16(v5, 13);       \
+        v3 = ROTLX16(v3, 16);       \
+        v7 = ROTLX16(v7, 16);       \
+        v1 = XORX16(v1, v0);        \
+        v5 = XORX16(v5, v4);        \
+        v3 = XORX16(v3, v2);        \
+        v7 = XORX16(v7, v6);        \
+        v0 = ROTLX16(v0, 32);       \
+        v4 = ROTLX16(v4, 32);       \
+        v2 = ADDX16(v2, v1);        \
+        v6 = ADDX16(v6, v5);        \
+        v0 = ADDX16(v0, v3);        \
+        v4 = ADDX16(v4, v7);        \
+        v1 = ROTLX16(v1, 17);       \
+        v5 = ROTLX16(v5, 17);       \
+        v3 = ROTLX16(v3, 21);       \
+        v7 = ROTLX16(v7, 21);       \
+        v1 = XORX16(v1, v2);        \
+        v5 = XORX16(v5, v6);        \
+        v3 = XORX16(v3, v0);        \
+        v7 = XORX16(v7, v4);        \
+        v2 = ROTLX16(v2, 32);       \
+        v6 = ROTLX16(v6, 32);       \
+    } while (0)
+
+#ifndef NSIPHASH
+#define NSIPHASH 16
+#endif
+
+#endif
+
 #ifndef NSIPHASH
 #define NSIPHASH 8
 #endif
 
 #endif
 
+#if defined(__SSE4_1__) || NSIPHASH == 4
+
+#include <smmintrin.h> // for _mm_* intrinsics
+
+// 4 way variant for cpus without AVX2, two interleaved sets of 2x64 bit lanes
+#define ADDX4(a, b) _mm_add_epi64(a, b)
+#define XORX4(a, b) _mm_xor_si128(a, b)
+#define ROT13X4(x) _mm_or_si128(_mm_slli_epi64(x, 13), _mm_srli_epi64(x, 51))
+#define ROT16X4(x) _mm_shuffle_epi8((x), _mm_set_epi64x(0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL))
+#define ROT17X4(x) _mm_or_si128(_mm_slli_epi64(x, 17), _mm_srli_epi64(x, 47))
+#define ROT21X4(x) _mm_or_si128(_mm_slli_epi64(x, 21), _mm_srli_epi64(x, 43))
+#define ROT32X4(x) _mm_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+#define SIPROUNDX4          \
+    do {                    \
+        v0 = ADDX4(v0, v1); \
+        v4 = ADDX4(v4, v5); \
+        v2 = ADDX4(v2, v3); \
+        v6 = ADDX4(v6, v7); \
+        v1 = ROT13X4(v1);   \
+        v5 = ROT13X4(v5);   \
+        v3 = ROT16X4(v3);   \
+        v7 = ROT16X4(v7);   \
+        v1 = XORX4(v1, v0); \
+        v5 = XORX4(v5, v4); \
+        v3 = XORX4(v3, v2); \
+        v7 = XORX4(v7, v6); \
+        v0 = ROT32X4(v0);   \
+        v4 = ROT32X4(v4);   \
+        v2 = ADDX4(v2, v1); \
+        v6 = ADDX4(v6, v5); \
+        v0 = ADDX4(v0, v3); \
+        v4 = ADDX4(v4, v7); \
+        v1 = ROT17X4(v1);   \
+        v5 = ROT17X4(v5);   \
+        v3 = ROT21X4(v3);   \
+        v7 = ROT21X4(v7);   \
+        v1 = XORX4(v1, v2); \
+        v5 = XORX4(v5, v6); \
+        v3 = XORX4(v3, v0); \
+        v7 = XORX4(v7, v4); \
+        v2 = ROT32X4(v2);   \
+        v6 = ROT32X4(v6);   \
+    } while (0)
+
+#ifndef NSIPHASH
+#define NSIPHASH 4
+#endif
+
+#endif
+
 #ifndef NSIPHASH
 #define NSIPHASH 1
 #endif
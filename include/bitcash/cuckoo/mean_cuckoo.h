@@ -33,18 +33,154 @@
 #define BITCASH_CUCKOO_MEAN_CUCKOO_H
 
 #include "bitcash/ctpl/ctpl.h"
+#include "bitcash/util/memory.hpp"
+#include "bitcash/util/proof.hpp"
 
-#include <set>
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace bitcash
 {
     namespace cuckoo
     {
-        using Cycle = std::set<uint32_t>;
+        using Cycle = util::Proof;
         using Cycles = std::vector<Cycle>;
 
+        // Instruction set a solver variant is compiled for
+        enum class Isa { Auto, Scalar, SSE41, AVX2, AVX512 };
+
+        const char* to_string(Isa);
+
+        // Best variant compiled in that the cpu supports, detected on first use
+        Isa BestIsa();
+
+        // All compiled in variants the cpu supports, best first
+        std::vector<Isa> AvailableIsas();
+
+        // How a solver trims. Mean buckets the edges themselves and needs
+        // gigabytes at high edgebits, lean keeps one alive bit per edge and
+        // rehashes them every round, trading time for memory.
+        enum class Engine { Mean, Lean };
+
+        const char* to_string(Engine);
+
+        // Engine named by to_string, throws on unknown names
+        Engine ParseEngine(const std::string&);
+
+        // Cancellation token. A graph remembers the epoch it was started
+        // under and is abandoned at the next trim round once it changes.
+        using Epoch = std::atomic<uint64_t>;
+
+        struct SolverOptions
+        {
+            int numa_node = -1; // allocate the bucket matrix on this node, -1 for anywhere
+            Isa isa = Isa::Auto; // ignored by the lean engine, which is scalar only
+            Engine engine = Engine::Mean;
+            int xbits = -1; // XBITS of the bucket matrix, -1 for the tuned profile or else the default
+            int ybits = -1; // YBITS each matrix row is sorted on, at least xbits, -1 for the tuned profile or else xbits
+            uint32_t barrier_spins = 4096; // spins between trim rounds before sleeping, 0 to always sleep
+            bool pipeline = false; // keep a second arena so solve_next can overlap two graphs
+            const Epoch* epoch = nullptr; // graphs are never abandoned without one
+            double min_trim_gain = 0.05; // stop trimming once a round pair removes less than this share of the edges, 0 for the full schedule
+            bool index_edges = false; // carry every edge's nonce through trimming in lanes beside the buckets instead of recovering cycle nonces with a sweep over all edges, edgebits up to 27, ignored by the lean engine
+            bool stream_stores = false; // stage the scatter into the bucket matrix in cache lines written out with non-temporal stores, ignored by the lean engine
+            bool fuse_degrees = false; // count U node degrees in a bitmap while generating edges so the first trim round filters without a counting sweep, 2^edgebits / 4 bytes more, ignored by the lean engine
+            int prefetch_distance = -1; // slots the trim rounds prefetch degree counters ahead of their reads, 0 for none, -1 for the tuned profile or else the default
+        };
+
+        struct SolverStats
+        {
+            Isa isa = Isa::Auto;
+            Engine engine = Engine::Mean;
+            int xbits = 0;
+            int ybits = 0;
+            util::PageBacking backing = util::PageBacking::Normal; // pages behind the bucket matrix
+            uint64_t memory_bytes = 0;
+            bool pipeline = false;
+            uint32_t trim_rounds = 0; // rounds the last graph was trimmed for
+            uint32_t compress_round = 0; // round the last graph was compressed at
+            bool index_edges = false; // cycle nonces are read from the nonce lanes
+            bool stream_stores = false; // matrix writes are staged and streamed
+            uint64_t streamed_bytes = 0; // matrix bytes the last graph wrote with non-temporal stores, none of them read for ownership
+            bool fuse_degrees = false; // U node degrees are counted during generation
+            int prefetch_distance = 0; // slots the trim rounds prefetch ahead
+            std::vector<double> round_seconds; // time each round of the last graph took, barrier wait included
+            uint64_t overflows = 0; // graphs that overflowed a bucket and were solved again by the lean engine, since the solver was made
+        };
+
+        // Solver keeps the trimming buffers for one (edgebits, threads)
+        // configuration alive between graphs, so repeated calls to solve
+        // do not pay for allocating and faulting in the bucket matrix.
+        class Solver
+        {
+            public:
+                Solver(
+                        uint8_t edgeBits,
+                        size_t threads_number,
+                        ctpl::thread_pool&,
+                        const SolverOptions& = SolverOptions{});
+                ~Solver();
+
+                Solver(const Solver&) = delete;
+                Solver& operator=(const Solver&) = delete;
+
+                // Find proofsize-length cuckoo cycles in the graph of the header
+                bool solve(
+                        const char* hex_header_hash,
+                        uint32_t hex_header_hash_len,
+                        uint8_t proofSize,
+                        Cycles& cycles);
+
+                // Pipelined solving, needs SolverOptions::pipeline. Starts trimming
+                // the graph of the header on the thread pool while the graph of
+                // the previous call is searched for cycles on the calling thread.
+                // The cycles returned belong to the previous header.
+                bool solve_next(
+                        const char* hex_header_hash,
+                        uint32_t hex_header_hash_len,
+                        uint8_t proofSize,
+                        Cycles& cycles);
+
+                // Search the graph of the last solve_next call, if any
+                bool flush(Cycles& cycles);
+
+                // Whether the graph whose cycles were last returned was abandoned
+                // because the epoch changed
+                bool cancelled() const;
+
+                const SolverStats& stats() const;
+                uint8_t edgebits() const;
+                size_t threads() const;
+
+                class Impl;
+
+            private:
+                uint8_t _edgebits;
+                size_t _threads;
+                std::unique_ptr<Impl> _impl;
+        };
+
+        // How the node bits above Z are split between the matrix (X) and the
+        // buckets each matrix row is sorted into (Y)
+        struct BucketSplit
+        {
+            int xbits;
+            int ybits;
+        };
+
+        // Splits the mean solver is compiled for at edgebits, the default first
+        std::vector<BucketSplit> AvailableSplits(uint8_t edgeBits);
+
+        // Memory a Solver with these options allocates, without allocating it
+        uint64_t SolverBytes(
+                uint8_t edgeBits,
+                size_t threads_number,
+                const SolverOptions& = SolverOptions{});
+
         // Find proofsize-length cuckoo cycle in random graph
+        // Allocates a fresh Solver for the call, prefer keeping a Solver around.
         bool FindCycles(
                 const char* hex_header_hash,
                 uint32_t hex_header_hash_len,
@@ -52,7 +188,9 @@ namespace bitcash
                 uint8_t proofSize,
                 Cycles& cycles,
                 size_t threads_number,
-                ctpl::thread_pool&);
+                ctpl::thread_pool&,
+                const Epoch* epoch = nullptr,
+                Engine engine = Engine::Mean);
     }
 }
 
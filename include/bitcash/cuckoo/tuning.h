@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#ifndef BITCASH_CUCKOO_TUNING_H
+#define BITCASH_CUCKOO_TUNING_H
+
+#include "bitcash/cuckoo/mean_cuckoo.h"
+
+#include <string>
+#include <vector>
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        struct CacheSizes
+        {
+            uint64_t l2 = 0; // per core, 0 when unknown
+            uint64_t l3 = 0; // shared, 0 when unknown
+        };
+
+        // Reads the cache sizes of cpu0 from /sys/devices/system/cpu
+        CacheSizes ReadCacheSizes();
+
+        // $BITCASH_XBITS_PROFILE, else .bitcash/xbits.profile in the home directory
+        std::string XbitsProfilePath();
+
+        // Split the profile picked for edgebits, from the entry with the
+        // closest thread count. -1, -1 without one. The profile is read once.
+        BucketSplit ProfileSplit(uint8_t edgeBits, size_t threads_number);
+
+        // Records split as the best for edgebits and threads in the profile
+        void SaveProfileSplit(uint8_t edgeBits, size_t threads_number, BucketSplit split);
+
+        // Prefetch distance picked for edgebits, from the entry with the
+        // closest thread count that has one. -1 without one.
+        int ProfilePrefetch(uint8_t edgeBits, size_t threads_number);
+
+        // Records distance as the best for edgebits and threads in the profile
+        void SaveProfilePrefetch(uint8_t edgeBits, size_t threads_number, int distance);
+
+        struct SplitTiming
+        {
+            BucketSplit split;
+            uint64_t counter_bytes; // per thread counters hit at random while trimming
+            bool skipped;           // counters do not fit L2 while another candidate's do
+            double seconds;         // per graph
+        };
+
+        // Times every compiled in split of edgebits on graphs graphs. Candidates
+        // whose counters overflow L2 are skipped when some other one fits.
+        std::vector<SplitTiming> TuneSplits(
+                uint8_t edgeBits,
+                size_t threads_number,
+                ctpl::thread_pool&,
+                SolverOptions options = SolverOptions{},
+                int graphs = 8);
+
+        struct PrefetchTiming
+        {
+            int distance;
+            double seconds;                   // per graph
+            std::vector<double> round_seconds; // of the last graph
+        };
+
+        // Times the trim rounds of edgebits with every candidate prefetch
+        // distance, 0 first, on graphs graphs with the split in options
+        std::vector<PrefetchTiming> TunePrefetch(
+                uint8_t edgeBits,
+                size_t threads_number,
+                ctpl::thread_pool&,
+                SolverOptions options = SolverOptions{},
+                int graphs = 8);
+    }
+}
+
+#endif // BITCASH_CUCKOO_TUNING_H
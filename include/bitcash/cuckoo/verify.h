@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#ifndef BITCASH_CUCKOO_VERIFY_H
+#define BITCASH_CUCKOO_VERIFY_H
+
+#include "bitcash/cuckoo/mean_cuckoo.h"
+
+#include <string>
+#include <vector>
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        // Why a proof was rejected, Ok when it is a cycle of the graph
+        enum class ProofStatus
+        {
+            Ok,
+            WrongLength,    // not proofsize nonces
+            NonceTooBig,    // a nonce is not an edge of the graph
+            DuplicateNonce, // an edge is used twice
+            NotACycle,      // the endpoints do not pair up into a closed path
+            Branch,         // a node has more than two edges of the proof
+            ShortCycle,     // the edges close a cycle before using all of them
+        };
+
+        const char* to_string(ProofStatus);
+
+        // Checks proof is a proofsize-length cycle in the graph of the header,
+        // hashing the edges with the best variant the cpu supports
+        ProofStatus VerifyProof(
+                const char* hex_header_hash,
+                uint32_t hex_header_hash_len,
+                uint8_t edgeBits,
+                uint8_t proofSize,
+                const Cycle& proof);
+
+        struct ProofCheck
+        {
+            std::string hex_header_hash;
+            uint8_t edgebits;
+            uint8_t proofsize;
+            Cycle proof;
+        };
+
+        // Status of each proof in checks, in order. Throws on edgebits
+        // outside 1..31 or an isa the cpu does not support.
+        std::vector<ProofStatus> VerifyProofs(
+                const std::vector<ProofCheck>& checks,
+                Isa isa = Isa::Auto);
+    }
+}
+
+#endif // BITCASH_CUCKOO_VERIFY_H
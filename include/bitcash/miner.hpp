@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <cstdint>
 
 namespace bitcash
 {
@@ -49,7 +50,35 @@ namespace bitcash
         int fan_speed;
     };
 
-    bool run_miner(Context*, int workers, int threads_per_worker, const std::vector<int>& gpu_devices);
+    struct MinerOptions
+    {
+        // bind each cpu worker to a NUMA node, pinning its threads to the
+        // cores of the node and allocating its solver memory there
+        bool numa = false;
+
+        // trim the next graph on the solver threads while the worker thread
+        // searches the previous one for cycles, needs twice the memory
+        bool pipeline = false;
+
+        // solver engine of each cpu worker, "mean" or "lean". lean needs a
+        // fraction of the memory but is several times slower and does not
+        // pipeline. workers past the end take the last entry, all run mean
+        // when empty.
+        std::vector<std::string> engines;
+
+        // bytes the cpu solvers may allocate together, 0 to take 90% of
+        // MemAvailable or of what the cgroup memory.max leaves, whichever
+        // is less. workers that do not fit give up pipelining, then move
+        // to the lean engine and finally wait for memory.
+        uint64_t memory_limit = 0;
+    };
+
+    bool run_miner(
+            Context*,
+            int workers,
+            int threads_per_worker,
+            const std::vector<int>& gpu_devices,
+            const MinerOptions& options = MinerOptions{});
     void stop_miner(Context*);
     bool is_stratum_running(Context*);
     bool is_miner_running(Context*);
@@ -73,14 +102,47 @@ namespace bitcash
         int shares;
     };
 
+    struct SolverStat
+    {
+        int worker;
+        std::string engine;
+        std::string isa;
+        std::string memory_backing;
+        uint64_t memory_bytes;
+        bool pipeline;
+    };
+
+    // What the memory governor decided for the cpu workers
+    struct MemoryStat
+    {
+        uint64_t budget_bytes;              // what the cpu solvers may allocate
+        uint64_t available_bytes;           // MemAvailable when the miner started, 0 if unknown
+        uint64_t cgroup_limit_bytes;        // memory.max of the cgroup, 0 when unlimited
+        uint64_t reserved_bytes;            // held by the solvers now
+        std::vector<int> downgraded_workers;// running without pipelining or on the lean engine to fit
+        std::vector<int> waiting_workers;   // idle until memory frees up
+    };
+
     using StatHistory = std::vector<MinerStat>;
     struct MinerStats
     {
         MinerStat total;
         MinerStat current;
         StatHistory history;
+        std::vector<SolverStat> solvers;
+        MemoryStat memory;
     };
 
     MinerStats get_miner_stats(Context*);
+
+    // A solver keeps its buffers between calls, so solving many headers with
+    // the same edgebits does not pay the setup cost for every graph.
+    struct Solver;
+    using Cycle = std::vector<uint32_t>;
+
+    Solver* create_solver(int edgebits, int threads, const std::string& engine = "mean");
+    void delete_solver(Solver*);
+    bool solve_header(Solver*, const std::string& hex_header_hash, std::vector<Cycle>& cycles);
+    SolverStat get_solver_stats(Solver*);
 }
 #endif //BITCASHMINER_H
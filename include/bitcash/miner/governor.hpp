@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give 
+ * permission to link the code of portions of this program with the 
+ * Botan library under certain conditions as described in each 
+ * individual source file, and distribute linked combinations 
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for 
+ * all of the code used other than Botan. If you modify file(s) with 
+ * this exception, you may extend this exception to your version of the 
+ * file(s), but you are not obligated to do so. If you do not wish to do 
+ * so, delete this exception statement from your version. If you delete 
+ * this exception statement from all source files in the program, then 
+ * also delete it here.
+ */
+#ifndef BITCASH_MINER_GOVERNOR_H
+#define BITCASH_MINER_GOVERNOR_H
+
+#include "bitcash/cuckoo/mean_cuckoo.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace bitcash
+{
+    namespace miner
+    {
+        // Memory the process may use, as seen when it was read
+        struct MemoryLimits
+        {
+            uint64_t available = 0;     // MemAvailable, 0 when unknown
+            uint64_t cgroup_limit = 0;  // tightest memory.max up the cgroup path, 0 when unlimited
+            uint64_t cgroup_free = 0;   // what that cgroup may still allocate
+        };
+
+        // Reads /proc/meminfo and the cgroup v2 (or v1) memory controller
+        MemoryLimits read_memory_limits();
+
+        // Hands out memory to the cpu solvers so the graphs in flight fit what
+        // the process may use. A solver that does not fit with the options its
+        // worker asked for runs without pipelining, then on the lean engine,
+        // and when even that does not fit the worker waits for memory.
+        class Governor
+        {
+            public:
+                // a limit other than 0 replaces the detected budget
+                explicit Governor(uint64_t limit = 0);
+
+                // Fits the options of a worker's next solver into the budget,
+                // replacing what the worker held before. False if it has to wait.
+                bool acquire(int worker, uint8_t edgebits, size_t threads, cuckoo::SolverOptions& options);
+                void release(int worker);
+
+                const MemoryLimits& limits() const;
+                uint64_t budget() const;
+                uint64_t reserved() const;
+                std::vector<int> downgraded() const;
+                std::vector<int> waiting() const;
+
+            private:
+                struct Grant
+                {
+                    uint64_t bytes;
+                    bool downgraded;
+                };
+
+            private:
+                MemoryLimits _limits;
+                uint64_t _budget;
+                std::map<int, Grant> _grants;
+                std::set<int> _waiting;
+                mutable std::mutex _mutex;
+        };
+    }
+}
+#endif
@@ -40,16 +40,26 @@
 #include <thread>
 #include <chrono>
 #include <deque>
+#include <memory>
 #include "bitcash/util/util.hpp"
+#include "bitcash/util/topology.hpp"
 #include "bitcash/stratum/stratum.hpp"
 #include "bitcash/miner.hpp"
 #include "bitcash/ctpl/ctpl.h"
+#include "bitcash/cuckoo/mean_cuckoo.h"
+#include "bitcash/miner/governor.hpp"
 
 #include <boost/optional.hpp>
 
 
 namespace bitcash
 {
+    namespace cuckoo
+    {
+        class Solver;
+        struct SolverStats;
+    }
+
     namespace miner
     {
         int GpuDevices();
@@ -64,13 +74,39 @@ namespace bitcash
                 enum State {Running, NotRunning};
 
                 Worker(const Worker& o);
-                Worker(int id, int threads, bool gpu_device, ctpl::thread_pool&, Miner&);
+                Worker(
+                        int id,
+                        int threads,
+                        bool gpu_device,
+                        ctpl::thread_pool&,
+                        Miner&,
+                        int node = -1,
+                        const std::vector<int>& cpus = {},
+                        bool pipeline = false,
+                        cuckoo::Engine engine = cuckoo::Engine::Mean);
+                ~Worker();
 
             public:
 
-                int id();
+                int id() const;
                 void run();
                 State state() const;
+                bool solver_stats(cuckoo::SolverStats&) const;
+
+            private:
+                cuckoo::Solver* solver(uint8_t edgebits);
+                void process(
+                        util::Work& work,
+                        const std::string& hex_header_hash,
+                        bool found,
+                        const cuckoo::Cycles& cycles);
+
+                // header whose graph is being trimmed in pipelined mode
+                struct PendingGraph
+                {
+                    util::Work work;
+                    std::string hex_header_hash;
+                };
 
             private:
                 std::atomic<State> _state;
@@ -79,6 +115,14 @@ namespace bitcash
                 bool _gpu_device;
                 ctpl::thread_pool& _pool;
                 Miner& _miner;
+                int _node;
+                std::vector<int> _cpus;
+                bool _pipeline;
+                cuckoo::Engine _engine;
+                bool _waiting;
+                std::unique_ptr<cuckoo::Solver> _solver;
+                boost::optional<PendingGraph> _pending;
+                mutable std::mutex _solver_mutex;
         };
 
         using Workers = std::vector<Worker>;
@@ -112,7 +156,8 @@ namespace bitcash
                         int workers,
                         int threads_per_worker,
                         const std::vector<int>& gpu_devices,
-                        util::SubmitWorkFunc submit_work);
+                        util::SubmitWorkFunc submit_work,
+                        const MinerOptions& options = MinerOptions{});
                 ~Miner();
 
             public:
@@ -129,22 +174,34 @@ namespace bitcash
 
                 util::MaybeWork next_work() const;
 
+                // bumped when in flight graphs should be abandoned
+                const std::atomic<uint64_t>& epoch() const;
+
                 int total_workers() const;
 
+                // memory the cpu solvers may take
+                Governor& governor();
+                const Governor& governor() const;
+
                 //Stats
                 Stats stats() const;
                 Stat total_stats() const;
                 const Stat& current_stat() const;
                 Stat& current_stat();
+                std::vector<std::pair<int, cuckoo::SolverStats>> solver_stats() const;
 
             private:
                 void wait_for_jobs();
 
             private:
                 std::atomic<State> _state;
+                std::atomic<uint64_t> _epoch;
                 ctpl::thread_pool _pool;
+                Governor _governor;
                 util::MaybeWork _next_work;
                 util::SubmitWorkFunc _submit_work;
+                util::NumaNodes _nodes;
+                std::vector<std::unique_ptr<ctpl::thread_pool>> _worker_pools;
                 Workers _workers;
                 std::vector<std::future<void>> _jobs;
                 Stats _stats;
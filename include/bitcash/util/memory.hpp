@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give 
+ * permission to link the code of portions of this program with the 
+ * Botan library under certain conditions as described in each 
+ * individual source file, and distribute linked combinations 
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for 
+ * all of the code used other than Botan. If you modify file(s) with 
+ * this exception, you may extend this exception to your version of the 
+ * file(s), but you are not obligated to do so. If you do not wish to do 
+ * so, delete this exception statement from your version. If you delete 
+ * this exception statement from all source files in the program, then 
+ * also delete it here.
+ */
+#ifndef BITCASH_MINER_UTIL_MEMORY_H
+#define BITCASH_MINER_UTIL_MEMORY_H
+
+#include <cstddef>
+
+namespace bitcash
+{
+    namespace util
+    {
+        // What kind of pages ended up behind a large allocation.
+        enum class PageBacking
+        {
+            Normal,         // regular 4KB pages
+            Transparent,    // madvise(MADV_HUGEPAGE), kernel may or may not collapse
+            Huge2M,         // MAP_HUGETLB with 2MB pages
+            Huge1G          // MAP_HUGETLB with 1GB pages
+        };
+
+        const char* to_string(PageBacking);
+
+        // Allocates bytes of anonymous memory trying 1GB and 2MB huge pages
+        // first, then falling back to transparent huge pages and finally
+        // normal pages. The memory is not prefaulted, see prefault.
+        // With node >= 0 the pages are preferably placed on that NUMA node.
+        void* alloc_large(size_t bytes, PageBacking& backing, int node = -1);
+        void free_large(void* p, size_t bytes, PageBacking backing);
+
+        // Faults in the pages of [p, p + bytes) for writing. Meant to be
+        // called on disjoint slices from several threads at once.
+        void prefault(void* p, size_t bytes);
+    }
+}
+#endif
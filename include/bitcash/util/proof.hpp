@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give 
+ * permission to link the code of portions of this program with the 
+ * Botan library under certain conditions as described in each 
+ * individual source file, and distribute linked combinations 
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for 
+ * all of the code used other than Botan. If you modify file(s) with 
+ * this exception, you may extend this exception to your version of the 
+ * file(s), but you are not obligated to do so. If you do not wish to do 
+ * so, delete this exception statement from your version. If you delete 
+ * this exception statement from all source files in the program, then 
+ * also delete it here.
+ */
+#ifndef BITCASH_MINER_UTIL_PROOF_H
+#define BITCASH_MINER_UTIL_PROOF_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace bitcash
+{
+    namespace util
+    {
+        // Nonces of the edges of one cuckoo cycle in ascending order, the
+        // form they are hashed and submitted in. Proofs of up to INLINE_SIZE
+        // nonces are kept inline, so a found cycle costs no allocation, only
+        // longer ones go to the heap.
+        class Proof
+        {
+            public:
+                static const size_t INLINE_SIZE = 42;
+
+                Proof() = default;
+
+                // copies the nonces of [first, last) and sorts them
+                template <typename It>
+                    Proof(It first, It last) : _size{static_cast<size_t>(std::distance(first, last))}
+                    {
+                        if(_size > INLINE_SIZE) {
+                            _spill.assign(first, last);
+                        } else {
+                            std::copy(first, last, _inline.begin());
+                        }
+                        std::sort(storage(), storage() + _size);
+                    }
+
+                size_t size() const { return _size; }
+                bool empty() const { return _size == 0; }
+
+                const uint32_t* data() const { return _size > INLINE_SIZE ? _spill.data() : _inline.data(); }
+                const uint32_t* begin() const { return data(); }
+                const uint32_t* end() const { return data() + _size; }
+                uint32_t operator[](size_t i) const { return data()[i]; }
+
+                bool operator==(const Proof& o) const { return std::equal(begin(), end(), o.begin(), o.end()); }
+                bool operator!=(const Proof& o) const { return !(*this == o); }
+
+            private:
+                uint32_t* storage() { return _size > INLINE_SIZE ? _spill.data() : _inline.data(); }
+
+                size_t _size = 0;
+                std::array<uint32_t, INLINE_SIZE> _inline;
+                std::vector<uint32_t> _spill;
+        };
+    }
+}
+#endif
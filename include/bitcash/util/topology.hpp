@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give 
+ * permission to link the code of portions of this program with the 
+ * Botan library under certain conditions as described in each 
+ * individual source file, and distribute linked combinations 
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for 
+ * all of the code used other than Botan. If you modify file(s) with 
+ * this exception, you may extend this exception to your version of the 
+ * file(s), but you are not obligated to do so. If you do not wish to do 
+ * so, delete this exception statement from your version. If you delete 
+ * this exception statement from all source files in the program, then 
+ * also delete it here.
+ */
+#ifndef BITCASH_MINER_UTIL_TOPOLOGY_H
+#define BITCASH_MINER_UTIL_TOPOLOGY_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bitcash
+{
+    namespace util
+    {
+        struct NumaNode
+        {
+            int id;
+            std::vector<int> cpus;
+        };
+
+        using NumaNodes = std::vector<NumaNode>;
+
+        // Reads the NUMA nodes that have cpus from /sys/devices/system/node.
+        // Returns a single node with all cpus when the information is missing.
+        NumaNodes numa_nodes();
+
+        // Parses a sysfs cpu list like "0-3,8,10-11"
+        std::vector<int> parse_cpu_list(const std::string&);
+
+        // Restricts a thread to the given cpus, returns false if it is not supported.
+        bool pin_thread(std::thread&, const std::vector<int>& cpus);
+        bool pin_current_thread(const std::vector<int>& cpus);
+    }
+}
+#endif
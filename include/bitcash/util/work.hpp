@@ -33,6 +33,7 @@
 #define BITCASH_MINER_WORK_H
 
 #include "bitcash/util/util.hpp"
+#include "bitcash/util/proof.hpp"
 
 #include <string>
 #include <array>
@@ -49,7 +50,7 @@ namespace bitcash
             std::string jobid;
             std::array<uint32_t, 32> data;
             std::array<uint32_t, 8> target;
-            std::array<uint32_t, 42> cycle;
+            Proof cycle;
 
             int height;
             std::string txs;
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 BitCash
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give 
+ * permission to link the code of portions of this program with the 
+ * Botan library under certain conditions as described in each 
+ * individual source file, and distribute linked combinations 
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for 
+ * all of the code used other than Botan. If you modify file(s) with 
+ * this exception, you may extend this exception to your version of the 
+ * file(s), but you are not obligated to do so. If you do not wish to do 
+ * so, delete this exception statement from your version. If you delete 
+ * this exception statement from all source files in the program, then 
+ * also delete it here.
+ */
+#include "bitcash/blake2/blake2.h"
+#include "bitcash/crypto/siphash.h"
+#include "bitcash/cuckoo/mean_cuckoo.h"
+#include "bitcash/cuckoo/tuning.h"
+#include "bitcash/cuckoo/verify.h"
+#include "bitcash/termcolor/termcolor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+using namespace bitcash;
+
+using BadProof = std::pair<cuckoo::ProofCheck, cuckoo::ProofStatus>;
+
+// Proofs --verify expects to be turned down, each with the status it expects.
+// Most are a found cycle with a nonce changed. A branch or a short cycle needs
+// endpoints that line up, so those are four edges of a graph of sixteen, made
+// of two pairs of edges joining the same two nodes and found by hashing here
+// rather than through the verifier.
+std::vector<BadProof> bad_proofs(const cuckoo::ProofCheck& good)
+{
+    std::vector<BadProof> res;
+    auto changed = [&](std::vector<std::uint32_t> nonces, cuckoo::ProofStatus status) {
+        cuckoo::ProofCheck c = good;
+        c.proof = cuckoo::Cycle(nonces.begin(), nonces.end());
+        res.emplace_back(c, status);
+    };
+
+    const std::vector<std::uint32_t> nonces(good.proof.begin(), good.proof.end());
+    auto n = nonces;
+    n.pop_back();
+    changed(n, cuckoo::ProofStatus::WrongLength);
+    n = nonces;
+    n.back() = 1U << good.edgebits;
+    changed(n, cuckoo::ProofStatus::NonceTooBig);
+    n = nonces;
+    n[1] = n[0];
+    changed(n, cuckoo::ProofStatus::DuplicateNonce);
+    n = nonces;
+    for (n[0] = 0; std::find(nonces.begin(), nonces.end(), n[0]) != nonces.end(); n[0]++) {
+    }
+    changed(n, cuckoo::ProofStatus::NotACycle);
+
+    const std::uint32_t edges = 16;
+    bool branch = false, shortcycle = false;
+    for (int h = 0; h < 100000 && !(branch && shortcycle); h++) {
+        char header[65];
+        std::snprintf(header, sizeof(header), "%064x", h);
+        char hdrkey[32];
+        blake2b((void *)hdrkey, sizeof(hdrkey), (const void *)header, 64, 0, 0);
+        crypto::siphash_keys keys;
+        crypto::setkeys(&keys, hdrkey);
+
+        std::uint32_t us[edges], vs[edges];
+        for (std::uint32_t e = 0; e < edges; e++) {
+            us[e] = crypto::_sipnode(&keys, edges - 1, e, 0);
+            vs[e] = crypto::_sipnode(&keys, edges - 1, e, 1);
+        }
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> twins;
+        for (std::uint32_t a = 0; a < edges; a++) {
+            for (std::uint32_t b = a + 1; b < edges; b++) {
+                if (us[a] == us[b] && vs[a] == vs[b]) {
+                    twins.emplace_back(a, b);
+                }
+            }
+        }
+        for (size_t p = 0; p < twins.size(); p++) {
+            for (size_t q = p + 1; q < twins.size(); q++) {
+                const auto a = twins[p].first, c = twins[q].first;
+                if (a == c || a == twins[q].second || twins[p].second == c || twins[p].second == twins[q].second) {
+                    continue;
+                }
+                const bool shared = us[a] == us[c] || vs[a] == vs[c];
+                if (shared ? branch : shortcycle) {
+                    continue;
+                }
+                const std::vector<std::uint32_t> four{a, twins[p].second, c, twins[q].second};
+                res.emplace_back(cuckoo::ProofCheck{header, 4, 4, cuckoo::Cycle(four.begin(), four.end())},
+                        shared ? cuckoo::ProofStatus::Branch : cuckoo::ProofStatus::ShortCycle);
+                (shared ? branch : shortcycle) = true;
+            }
+        }
+    }
+    return res;
+}
+
+// Times the cpu solver on a fixed series of headers for each instruction set
+// variant, so the variants can be compared on the same graphs.
+int main(int argc, char** argv)
+{
+    po::options_description desc("Allowed options");
+    std::vector<std::string> isa_names;
+    desc.add_options()
+        ("help,h", "show the help message")
+        ("edgebits,e", po::value<int>()->default_value(24), "Graph size in edge bits.")
+        ("graphs,n", po::value<int>()->default_value(20), "Number of graphs to solve per variant.")
+        ("threads,t", po::value<int>()->default_value(std::thread::hardware_concurrency()), "Number of solver threads.")
+        ("proofsize,p", po::value<int>()->default_value(42), "Cycle length to look for.")
+        ("engine", po::value<std::string>()->default_value("mean"), "Solver engine, mean or lean. Lean is scalar only and runs once whatever --isa says.")
+        ("xbits", po::value<int>()->default_value(-1), "XBITS of the bucket matrix, -1 for the tuned profile or the default.")
+        ("ybits", po::value<int>()->default_value(-1), "YBITS each matrix row is sorted on, at least XBITS, -1 for the tuned profile or XBITS.")
+        ("tune", "Time every compiled in XBITS and YBITS split, then every prefetch distance on the fastest, for the edgebits and threads and save the best to the profile.")
+        ("pipeline", "Overlap trimming of each graph with the cycle search of the previous one.")
+        ("verify", "Time proof verification on the cycles of the graphs instead of solving.")
+        ("index", "Carry edge nonces through trimming instead of recovering them, edgebits up to 27.")
+        ("stream", "Stage the writes into the bucket matrix and stream full cache lines out with non-temporal stores.")
+        ("fuse", "Count U node degrees while generating edges instead of in a sweep of the first trim round.")
+        ("prefetch", po::value<int>()->default_value(-1), "Slots the trim rounds prefetch degree counters ahead, 0 for none, -1 for the tuned profile or the default.")
+        ("rounds", "Print how long each trim round of the last graph took.")
+        ("trim-gain", po::value<double>()->default_value(cuckoo::SolverOptions{}.min_trim_gain), "Stop trimming once a round pair removes less than this share of the edges.")
+        ("spins", po::value<std::uint32_t>()->default_value(cuckoo::SolverOptions{}.barrier_spins), "Spins at the trim round barrier before sleeping.")
+        ("isa", po::value<std::vector<std::string>>(&isa_names)->multitoken(), "Variant to run (scalar, sse4.1, avx2, avx512), all available by default.");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    const int edgebits = vm["edgebits"].as<int>();
+    const int graphs = vm["graphs"].as<int>();
+    const int threads = std::max(1, vm["threads"].as<int>());
+    const int proofsize = vm["proofsize"].as<int>();
+
+    cuckoo::Engine engine;
+    try {
+        engine = cuckoo::ParseEngine(vm["engine"].as<std::string>());
+    } catch (const std::exception& e) {
+        std::cerr << termcolor::red << e.what() << termcolor::reset << std::endl;
+        return 1;
+    }
+
+    auto available = cuckoo::AvailableIsas();
+    std::vector<cuckoo::Isa> isas;
+    if (isa_names.empty()) {
+        isas = available;
+    }
+    for (const auto& name : isa_names) {
+        auto isa = std::find_if(available.begin(), available.end(),
+                [&name](cuckoo::Isa i) { return name == cuckoo::to_string(i); });
+        if (isa == available.end()) {
+            std::cerr << termcolor::red << "instruction set " << name << " is not available on this cpu" << termcolor::reset << std::endl;
+            return 1;
+        }
+        isas.push_back(*isa);
+    }
+
+    if (engine == cuckoo::Engine::Lean) {
+        isas = {cuckoo::Isa::Scalar};
+    }
+
+    ctpl::thread_pool pool(threads);
+
+    if (vm.count("tune")) {
+        const auto caches = cuckoo::ReadCacheSizes();
+        std::cout << "tuning splits for edgebits: " << edgebits << " threads: " << threads
+                  << " l2: " << caches.l2 / 1024 << "KB l3: " << caches.l3 / 1024 << "KB" << std::endl;
+
+        cuckoo::SolverOptions options;
+        options.isa = isas.front();
+        options.barrier_spins = vm["spins"].as<std::uint32_t>();
+        options.min_trim_gain = vm["trim-gain"].as<double>();
+
+        try {
+            const auto timings = cuckoo::TuneSplits(edgebits, threads, pool, options, graphs);
+            const cuckoo::SplitTiming* best = nullptr;
+            for (const auto& t : timings) {
+                std::cout << "xbits " << t.split.xbits << " ybits " << t.split.ybits << " counters: " << t.counter_bytes / 1024 << "KB";
+                if (t.skipped) {
+                    std::cout << " skipped, counters overflow l2" << std::endl;
+                    continue;
+                }
+                std::cout << " graphs/s: " << termcolor::cyan << std::fixed << std::setprecision(3) << 1 / t.seconds << termcolor::reset << std::endl;
+                if (!best || t.seconds < best->seconds) {
+                    best = &t;
+                }
+            }
+
+            cuckoo::SaveProfileSplit(edgebits, threads, best->split);
+            std::cout << "saved xbits " << best->split.xbits << " ybits " << best->split.ybits
+                      << " to " << cuckoo::XbitsProfilePath() << std::endl;
+
+            options.xbits = best->split.xbits;
+            options.ybits = best->split.ybits;
+            const auto distances = cuckoo::TunePrefetch(edgebits, threads, pool, options, graphs);
+            const cuckoo::PrefetchTiming* fastest = nullptr;
+            for (const auto& t : distances) {
+                std::cout << "prefetch " << t.distance << " graphs/s: " << termcolor::cyan << std::fixed << std::setprecision(3) << 1 / t.seconds << termcolor::reset << std::endl;
+                if (!fastest || t.seconds < fastest->seconds) {
+                    fastest = &t;
+                }
+            }
+
+            cuckoo::SaveProfilePrefetch(edgebits, threads, fastest->distance);
+            std::cout << "saved prefetch " << fastest->distance << " to " << cuckoo::XbitsProfilePath() << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << termcolor::red << e.what() << termcolor::reset << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (vm.count("verify")) {
+        std::vector<cuckoo::ProofCheck> checks;
+        try {
+            cuckoo::Solver solver(edgebits, threads, pool);
+            for (int i = 0; i < graphs; i++) {
+                char header[65];
+                std::snprintf(header, sizeof(header), "%064x", i);
+                cuckoo::Cycles cycles;
+                solver.solve(header, 64, proofsize, cycles);
+                for (auto& c : cycles) {
+                    checks.push_back({header, static_cast<std::uint8_t>(edgebits), static_cast<std::uint8_t>(proofsize), c});
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << termcolor::red << e.what() << termcolor::reset << std::endl;
+            return 1;
+        }
+        if (checks.empty()) {
+            std::cerr << termcolor::red << "no cycles in " << graphs << " graphs to verify, raise --graphs" << termcolor::reset << std::endl;
+            return 1;
+        }
+
+        // every variant must turn the bad proofs down for the right reason,
+        // checked in one batch with the good ones to mix keys and edgebits
+        auto batch = checks;
+        const auto bad = bad_proofs(checks.front());
+        for (const auto& b : bad) {
+            batch.push_back(b.first);
+        }
+        for (auto isa : isas) {
+            const auto statuses = cuckoo::VerifyProofs(batch, isa);
+            for (size_t i = 0; i < bad.size(); i++) {
+                const auto status = statuses[checks.size() + i];
+                if (status != bad[i].second) {
+                    std::cerr << termcolor::red << cuckoo::to_string(isa) << ": a proof with a "
+                              << cuckoo::to_string(bad[i].second) << " came back " << cuckoo::to_string(status)
+                              << termcolor::reset << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        std::cout << "verifying " << checks.size() << " proofs of edgebits: " << edgebits << " proofsize: " << proofsize
+                  << ", " << bad.size() << " bad ones turned down" << std::endl;
+        for (auto isa : isas) {
+            // repeat the batch for a second or so to get a stable rate
+            size_t verified = 0;
+            double seconds = 0;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                for (auto status : cuckoo::VerifyProofs(checks, isa)) {
+                    if (status != cuckoo::ProofStatus::Ok) {
+                        std::cerr << termcolor::red << cuckoo::to_string(isa) << ": a found cycle failed to verify, "
+                                  << cuckoo::to_string(status) << termcolor::reset << std::endl;
+                        return 1;
+                    }
+                }
+                verified += checks.size();
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (seconds < 1);
+
+            std::cout << std::left << std::setw(8) << cuckoo::to_string(isa) << std::right << std::fixed
+                      << " proofs/s: " << termcolor::cyan << std::setprecision(0) << verified / seconds << termcolor::reset << std::endl;
+        }
+        return 0;
+    }
+
+    std::cout << "engine: " << cuckoo::to_string(engine) << " edgebits: " << edgebits << " graphs: " << graphs
+              << " threads: " << threads << " proofsize: " << proofsize << std::endl;
+
+    struct Result
+    {
+        cuckoo::Isa isa;
+        double seconds;
+        int cycles;
+        cuckoo::SolverStats stats;
+    };
+    std::vector<Result> results;
+
+    for (auto isa : isas) {
+        cuckoo::SolverOptions options;
+        options.isa = isa;
+        options.engine = engine;
+        options.xbits = vm["xbits"].as<int>();
+        options.ybits = vm["ybits"].as<int>();
+        options.barrier_spins = vm["spins"].as<std::uint32_t>();
+        options.pipeline = vm.count("pipeline") > 0;
+        options.index_edges = vm.count("index") > 0;
+        options.stream_stores = vm.count("stream") > 0;
+        options.fuse_degrees = vm.count("fuse") > 0;
+        options.prefetch_distance = vm["prefetch"].as<int>();
+        options.min_trim_gain = vm["trim-gain"].as<double>();
+
+        try {
+            cuckoo::Solver solver(edgebits, threads, pool, options);
+
+            Result result{isa, 0, 0, solver.stats()};
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < graphs; i++) {
+                char header[65];
+                std::snprintf(header, sizeof(header), "%064x", i);
+                cuckoo::Cycles cycles;
+                if (options.pipeline) {
+                    solver.solve_next(header, 64, proofsize, cycles);
+                } else {
+                    solver.solve(header, 64, proofsize, cycles);
+                }
+                result.cycles += cycles.size();
+            }
+            if (options.pipeline) {
+                cuckoo::Cycles cycles;
+                solver.flush(cycles);
+                result.cycles += cycles.size();
+            }
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.stats = solver.stats();
+            results.push_back(result);
+        } catch (const std::exception& e) {
+            std::cerr << termcolor::red << cuckoo::to_string(isa) << ": " << e.what() << termcolor::reset << std::endl;
+            return 1;
+        }
+    }
+
+    // edges/s counts every edge of the generated graph, trimmed or not
+    auto edgesps = [edgebits, graphs](const Result& r) { return graphs * double(1ULL << edgebits) / r.seconds; };
+    auto avx2 = std::find_if(results.begin(), results.end(),
+            [](const Result& r) { return r.isa == cuckoo::Isa::AVX2; });
+
+    for (const auto& r : results) {
+        std::cout << std::left << std::setw(8) << cuckoo::to_string(r.isa) << std::right << std::fixed
+                  << " graphs/s: " << termcolor::cyan << std::setprecision(3) << graphs / r.seconds << termcolor::reset
+                  << " Medges/s: " << termcolor::cyan << std::setprecision(1) << edgesps(r) / 1e6 << termcolor::reset
+                  << " cycles: " << r.cycles
+                  << " xbits: " << r.stats.xbits << " ybits: " << r.stats.ybits
+                  << " trims: " << r.stats.trim_rounds << " compress: " << r.stats.compress_round
+                  << " nonces: " << (r.stats.index_edges ? "lanes" : "recovered")
+                  << " degrees: " << (r.stats.fuse_degrees ? "fused" : "counted")
+                  << " memory: " << r.stats.memory_bytes / (1024 * 1024) << "MB on " << util::to_string(r.stats.backing);
+        if (r.stats.stream_stores) {
+            // every streamed line is one the cpu did not read for ownership
+            // first, an estimate from the last graph
+            std::cout << " streamed: " << r.stats.streamed_bytes / (1024 * 1024) << "MB/graph"
+                      << " rfo saved: " << std::setprecision(2) << r.stats.streamed_bytes * graphs / r.seconds / 1e9 << "GB/s";
+        }
+        if (r.stats.engine == cuckoo::Engine::Mean) {
+            std::cout << " prefetch: " << r.stats.prefetch_distance
+                      << " overflowed: " << r.stats.overflows;
+        }
+        if (avx2 != results.end()) {
+            std::cout << " vs avx2: " << std::setprecision(2) << edgesps(r) / edgesps(*avx2) << "x";
+        }
+        std::cout << std::endl;
+        if (vm.count("rounds") && !r.stats.round_seconds.empty()) {
+            std::cout << "  round ms:" << std::setprecision(2);
+            for (double seconds : r.stats.round_seconds) {
+                std::cout << " " << seconds * 1e3;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    return 0;
+}
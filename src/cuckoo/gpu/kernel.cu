@@ -39,6 +39,7 @@
 #include "exceptions.h"
 #include "bitcash/nvml/nvml.h"
 #include "bitcash/termcolor/termcolor.hpp"
+#include "bitcash/util/proof.hpp"
 #include <xmmintrin.h>
 #include <algorithm>
 #include <stdio.h>
@@ -708,7 +709,7 @@ using Edge = std::pair<node_t, node_t>;
 template <class P>
 void SolutionSlow(
         const SipKeys& keys,
-        std::set<uint32_t >& nonces,
+        bitcash::util::Proof& nonces,
         node_t* us, u32 nu,
         node_t* vs, u32 nv) {
 
@@ -725,6 +726,7 @@ void SolutionSlow(
         cycle.insert(e); // u's in odd position; v's in even
     }
 
+    std::vector<uint32_t> found;
     for (u64 nonce = 0; nonce < P::NEDGES; nonce++) {
         u64 u = host_dipnode<P::EDGEMASK>(keys.k0, keys.k1, keys.k2, keys.k3, nonce, 0) << 1;
         u64 v = host_dipnode<P::EDGEMASK>(keys.k0, keys.k1, keys.k2, keys.k3, nonce, 1) << 1 | 1;
@@ -732,17 +734,18 @@ void SolutionSlow(
         Edge e{u,v};
 
         if (cycle.find(e) != cycle.end()) {
-            nonces.insert(nonce);
+            found.push_back(nonce);
             cycle.erase(e);
         }
     }
+    nonces = bitcash::util::Proof(found.begin(), found.end());
 }
 
 template <class P>
 void Solution(
         uint8_t proof_size,
         const SipKeys& keys,
-        std::set<uint32_t >& nonces,
+        bitcash::util::Proof& nonces,
         node_t* us, u32 nu,
         node_t* vs, u32 nv,
         int* buffer_a,
@@ -778,12 +781,10 @@ void Solution(
             recovery);
     cudaDeviceSynchronize();
     cudaMemcpy(host_nonces, indexes_e2, proof_size * 8, cudaMemcpyDeviceToHost);
-    for(int j = 0; j < i; j++) {
-        nonces.insert(host_nonces[j]);
-    }
+    nonces = bitcash::util::Proof(host_nonces, host_nonces + i);
 }
 
-using Cycle = std::set<uint32_t>;
+using Cycle = bitcash::util::Proof;
 using Cycles = std::vector<Cycle>;
 
 template <class P>
@@ -881,7 +882,7 @@ int SetupKernelBuffers() {
     return count;
 }
 
-using Cycle = std::set<uint32_t>;
+using Cycle = bitcash::util::Proof;
 
 template <class offset_t, uint8_t EDGEBITS, uint8_t XBITS>
 struct Run
@@ -0,0 +1,512 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+
+// The lean solver keeps one alive bit per edge instead of the edges
+// themselves. Each trimming round recomputes the endpoint of every alive
+// edge on one side, counts the endpoints in a two bit per node set and then
+// kills the edges whose endpoint was seen only once. The node set covers
+// one of NPARTS node partitions at a time, so with the alive bits it needs
+// about 2^EDGEBITS / 8 * 1.5 bytes, at the price of hashing every alive
+// edge twice per partition and round. The cycle search on the at most
+// 2^EDGEBITS / 128 edges left takes about as much again.
+
+#include "solver_impl.h"
+
+#include "bitcash/crypto/siphash.h"
+#include "bitcash/blake2/blake2.h"
+#include "bitcash/util/memory.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        namespace
+        {
+            const int MAXPATHLEN = 8192;
+            const std::uint16_t MIN_EDGE_BITS = 16;
+            const std::uint16_t MAX_EDGE_BITS = 31;
+
+            // node partitions counted one after the other in a round
+            const std::uint32_t PARTBITS = 2;
+            const std::uint32_t NPARTS = 1 << PARTBITS;
+            const std::uint32_t PARTMASK = NPARTS - 1;
+
+            const std::uint32_t CUCKOO_NIL = ~0;
+
+            void check_edgebits(const std::uint8_t edgeBits)
+            {
+                if (edgeBits < MIN_EDGE_BITS || edgeBits > MAX_EDGE_BITS) {
+                    std::stringstream s;
+                    s << "lean solver: EDGEBITS equal to " << static_cast<int>(edgeBits) << " is not supported";
+                    throw std::runtime_error{s.str()};
+                }
+            }
+
+            // one alive bit per edge
+            std::size_t alivebytes(const std::uint8_t edgeBits)
+            {
+                return (std::size_t(1) << edgeBits) / 8;
+            }
+
+            // two bits per node of one partition
+            std::size_t twicebytes(const std::uint8_t edgeBits)
+            {
+                return (std::size_t(1) << (edgeBits - PARTBITS)) / 4;
+            }
+
+            // edges the cycle search takes at most, the early stop bound of
+            // trimming. a graph left with more after the last round is dropped.
+            std::size_t searchedges(const std::uint8_t edgeBits)
+            {
+                return (std::size_t(1) << edgeBits) / 128;
+            }
+
+            // slots of the node map for keys keys, at most half full
+            std::size_t mapslots(const std::size_t keys)
+            {
+                std::size_t size = 1024;
+                while (size < 2 * keys)
+                    size <<= 1;
+                return size;
+            }
+
+            // the surviving edges and the node map of the cycle search
+            std::size_t searchbytes(const std::uint8_t edgeBits)
+            {
+                return searchedges(edgeBits) * sizeof(std::uint32_t) + mapslots(searchedges(edgeBits)) * 2 * sizeof(std::uint32_t);
+            }
+
+            // two bits per node, the low one set once the node is seen and the
+            // high one once it is seen again
+            class TwiceSet
+            {
+                public:
+                    TwiceSet(std::uint64_t* bitsIn) : bits{bitsIn} {}
+
+                    template <bool SHARED>
+                        void set(const std::uint32_t n)
+                        {
+                            std::uint64_t* w = bits + (n >> 5);
+                            const std::uint64_t once = 1ULL << (2 * (n & 31));
+                            if (SHARED) {
+                                if (__atomic_fetch_or(w, once, __ATOMIC_RELAXED) & once)
+                                    __atomic_fetch_or(w, once << 1, __ATOMIC_RELAXED);
+                            } else {
+                                *w |= once | ((*w & once) << 1);
+                            }
+                        }
+
+                    bool test(const std::uint32_t n) const
+                    {
+                        return (bits[n >> 5] >> (2 * (n & 31) + 1)) & 1;
+                    }
+
+                private:
+                    std::uint64_t* bits;
+            };
+
+            // open addressing map from node to node for the cycle search, at
+            // most half full since every edge adds at most one key
+            class NodeMap
+            {
+                public:
+                    void reset(const std::size_t keys)
+                    {
+                        const std::size_t size = mapslots(keys);
+                        mask = size - 1;
+                        slots.assign(size, Slot{CUCKOO_NIL, CUCKOO_NIL});
+                    }
+
+                    std::uint32_t operator[](const std::uint32_t key) const
+                    {
+                        for (std::size_t i = hash(key);; i = (i + 1) & mask) {
+                            if (slots[i].key == key || slots[i].key == CUCKOO_NIL)
+                                return slots[i].value;
+                        }
+                    }
+
+                    void set(const std::uint32_t key, const std::uint32_t value)
+                    {
+                        for (std::size_t i = hash(key);; i = (i + 1) & mask) {
+                            if (slots[i].key == key || slots[i].key == CUCKOO_NIL) {
+                                slots[i] = Slot{key, value};
+                                return;
+                            }
+                        }
+                    }
+
+                    std::size_t bytes() const
+                    {
+                        return slots.size() * sizeof(Slot);
+                    }
+
+                private:
+                    struct Slot
+                    {
+                        std::uint32_t key;
+                        std::uint32_t value;
+                    };
+
+                    std::size_t hash(const std::uint32_t key) const
+                    {
+                        return (key * 0x9e3779b97f4a7c15ULL >> 32) & mask;
+                    }
+
+                    std::vector<Slot> slots;
+                    std::size_t mask = 0;
+            };
+
+            class lean_solver : public Solver::Impl
+            {
+                public:
+                    lean_solver(
+                            std::uint8_t edgeBitsIn,
+                            size_t threadsIn,
+                            ctpl::thread_pool& poolIn,
+                            const SolverOptions& options) :
+                        edgeBits{edgeBitsIn},
+                        threads{std::max<size_t>(threadsIn, 1)},
+                        pool{poolIn},
+                        nTrims{edgeBitsIn >= 30 ? 96u : 68u},
+                        epoch{options.epoch},
+                        min_gain{options.min_trim_gain}
+                    {
+                        check_edgebits(edgeBits);
+                        if (options.pipeline) {
+                            throw std::runtime_error{"the lean solver does not support SolverOptions::pipeline"};
+                        }
+
+                        edgemask = (1U << edgeBits) - 1;
+                        words = (std::uint64_t(1) << edgeBits) / 64;
+                        alive = static_cast<std::uint64_t*>(util::alloc_large(alivebytes(edgeBits), alive_backing, options.numa_node));
+                        twice_bits = static_cast<std::uint64_t*>(util::alloc_large(twicebytes(edgeBits), twice_backing, options.numa_node));
+                        counts.resize(threads);
+                        edges.reserve(searchedges(edgeBits));
+
+                        _stats.isa = Isa::Scalar;
+                        _stats.engine = Engine::Lean;
+                        _stats.backing = alive_backing;
+                        _stats.memory_bytes = lean_solver_bytes(edgeBits);
+                    }
+
+                    ~lean_solver()
+                    {
+                        util::free_large(alive, alivebytes(edgeBits), alive_backing);
+                        util::free_large(twice_bits, twicebytes(edgeBits), twice_backing);
+                    }
+
+                    bool solve(
+                            const char* hex_header_hash,
+                            uint32_t hex_header_hash_len,
+                            std::uint8_t proofSizeIn,
+                            Cycles& cycles) override
+                    {
+                        assert(hex_header_hash != nullptr);
+                        assert(hex_header_hash_len > 0);
+
+                        char hdrkey[32];
+                        blake2b((void *)hdrkey, sizeof(hdrkey), (const void *)hex_header_hash, hex_header_hash_len, 0, 0);
+                        crypto::setkeys(&sip_keys, hdrkey);
+                        proofSize = proofSizeIn;
+                        start_epoch = epoch ? epoch->load() : 0;
+
+                        _cancelled = !trim();
+                        if (_cancelled) {
+                            return false;
+                        }
+                        return findcycles(cycles);
+                    }
+
+                    bool solve_next(
+                            const char* /*hex_header_hash*/,
+                            uint32_t /*hex_header_hash_len*/,
+                            std::uint8_t /*proofSize*/,
+                            Cycles& /*cycles*/) override
+                    {
+                        throw std::runtime_error{"solve_next: the lean solver does not pipeline"};
+                    }
+
+                    bool flush(Cycles& /*cycles*/) override
+                    {
+                        return false;
+                    }
+
+                private:
+                    std::uint32_t node(const std::uint32_t edge, const std::uint32_t uorv) const
+                    {
+                        return crypto::_sipnode(&sip_keys, edgemask, edge, uorv);
+                    }
+
+                    // runs f on every thread's slice of the alive words and waits
+                    template <typename F>
+                        void parallel(F&& f)
+                        {
+                            auto slice = [this, &f](std::uint32_t t) {
+                                f(t, words * t / threads, words * (t + 1) / threads);
+                            };
+
+                            if (threads == 1) {
+                                slice(0);
+                                return;
+                            }
+
+                            std::vector<std::future<void>> jobs;
+                            for (std::uint32_t t = 0; t < threads; t++) {
+                                jobs.push_back(pool.push([t, &slice](int) { slice(t); }));
+                            }
+                            for (auto& j : jobs) {
+                                j.wait();
+                            }
+                        }
+
+                    template <bool SHARED>
+                        void count(const std::size_t begin, const std::size_t end, const std::uint32_t uorv, const std::uint32_t part)
+                        {
+                            TwiceSet twice{twice_bits};
+                            for (std::size_t w = begin; w < end; w++) {
+                                for (std::uint64_t bits = alive[w]; bits; bits &= bits - 1) {
+                                    const std::uint32_t n = node(w * 64 + __builtin_ctzll(bits), uorv);
+                                    if ((n & PARTMASK) == part)
+                                        twice.set<SHARED>(n >> PARTBITS);
+                                }
+                            }
+                        }
+
+                    std::uint64_t kill(const std::size_t begin, const std::size_t end, const std::uint32_t uorv, const std::uint32_t part)
+                    {
+                        const TwiceSet twice{twice_bits};
+                        std::uint64_t live = 0;
+                        for (std::size_t w = begin; w < end; w++) {
+                            std::uint64_t keep = alive[w];
+                            for (std::uint64_t bits = keep; bits; bits &= bits - 1) {
+                                const std::uint32_t b = __builtin_ctzll(bits);
+                                const std::uint32_t n = node(w * 64 + b, uorv);
+                                if ((n & PARTMASK) == part && !twice.test(n >> PARTBITS))
+                                    keep &= ~(1ULL << b);
+                            }
+                            alive[w] = keep;
+                            live += __builtin_popcountll(keep);
+                        }
+                        return live;
+                    }
+
+                    // false if the graph was abandoned because the epoch changed
+                    bool trim()
+                    {
+                        parallel([this](std::uint32_t, std::size_t begin, std::size_t end) {
+                                std::memset(alive + begin, 0xff, (end - begin) * sizeof(std::uint64_t));
+                                });
+
+                        const std::uint64_t nedges = std::uint64_t(1) << edgeBits;
+                        std::uint64_t lastcount = nedges;
+                        std::uint32_t round = 0;
+                        for (; round < nTrims; round++) {
+                            if (epoch && epoch->load(std::memory_order_relaxed) != start_epoch) {
+                                return false;
+                            }
+
+                            const std::uint32_t uorv = round & 1;
+                            for (std::uint32_t part = 0; part < NPARTS; part++) {
+                                parallel([this](std::uint32_t t, std::size_t, std::size_t) {
+                                        const std::size_t size = twicebytes(edgeBits) / sizeof(std::uint64_t);
+                                        const std::size_t from = size * t / threads, to = size * (t + 1) / threads;
+                                        std::memset(twice_bits + from, 0, (to - from) * sizeof(std::uint64_t));
+                                        });
+                                parallel([this, uorv, part](std::uint32_t, std::size_t begin, std::size_t end) {
+                                        if (threads == 1)
+                                            count<false>(begin, end, uorv, part);
+                                        else
+                                            count<true>(begin, end, uorv, part);
+                                        });
+                                parallel([this, uorv, part](std::uint32_t t, std::size_t begin, std::size_t end) {
+                                        counts[t] = kill(begin, end, uorv, part);
+                                        });
+                            }
+
+                            // like the mean solver, stop once a round pair gains little,
+                            // but only when the node map for the search stays within
+                            // the alive bits
+                            if (uorv) {
+                                std::uint64_t live = 0;
+                                for (auto c : counts)
+                                    live += c;
+                                if (lastcount - live < lastcount * min_gain && live <= nedges / 128) {
+                                    round++;
+                                    break;
+                                }
+                                lastcount = live;
+                            }
+                        }
+
+                        _stats.trim_rounds = round;
+                        _stats.compress_round = 0;
+                        return true;
+                    }
+
+                    std::uint32_t path(std::uint32_t u, std::uint32_t* us) const
+                    {
+                        std::uint32_t nu;
+                        for (nu = 0; u != CUCKOO_NIL; u = cuckoo[u]) {
+                            if (nu >= MAXPATHLEN) {
+                                while (nu-- && us[nu] != u)
+                                    ;
+                                break;
+                            }
+                            us[nu++] = u;
+                        }
+                        return nu - 1;
+                    }
+
+                    // nonces of the edges on the cycle, taken from the surviving edges
+                    void solution(const std::uint32_t* us, std::uint32_t nu, const std::uint32_t* vs, std::uint32_t nv, Cycles& cycles) const
+                    {
+                        // endpoints of a cycle edge packed as u << 32 | v
+                        std::vector<std::uint64_t> pairs;
+                        auto record = [&pairs](std::uint32_t u2, std::uint32_t v2) {
+                            pairs.push_back(std::uint64_t(u2 >> 1) << 32 | (v2 >> 1));
+                        };
+                        record(*us, *vs);
+                        while (nu--)
+                            record(us[(nu + 1) & ~1], us[nu | 1]); // u's in even position; v's in odd
+                        while (nv--)
+                            record(vs[nv | 1], vs[(nv + 1) & ~1]); // u's in odd position; v's in even
+                        std::sort(pairs.begin(), pairs.end());
+
+                        std::vector<std::uint32_t> nonces;
+                        std::vector<bool> taken(pairs.size());
+                        for (const auto edge : edges) {
+                            const std::uint64_t pair = std::uint64_t(node(edge, 0)) << 32 | node(edge, 1);
+                            auto it = std::lower_bound(pairs.begin(), pairs.end(), pair);
+                            for (; it != pairs.end() && *it == pair; it++) {
+                                if (!taken[it - pairs.begin()]) {
+                                    taken[it - pairs.begin()] = true;
+                                    nonces.push_back(edge);
+                                    break;
+                                }
+                            }
+                        }
+                        assert(nonces.size() == proofSize);
+                        cycles.emplace_back(nonces.begin(), nonces.end());
+                    }
+
+                    bool findcycles(Cycles& cycles)
+                    {
+                        // keep the search within lean_solver_bytes
+                        std::size_t live = 0;
+                        for (std::size_t w = 0; w < words; w++)
+                            live += __builtin_popcountll(alive[w]);
+                        if (live > searchedges(edgeBits))
+                            return false;
+
+                        edges.clear();
+                        for (std::size_t w = 0; w < words; w++) {
+                            for (std::uint64_t bits = alive[w]; bits; bits &= bits - 1)
+                                edges.push_back(w * 64 + __builtin_ctzll(bits));
+                        }
+                        cuckoo.reset(edges.size());
+
+                        std::vector<std::uint32_t> us(MAXPATHLEN), vs(MAXPATHLEN);
+                        bool found = false;
+                        for (const auto edge : edges) {
+                            const std::uint32_t u0 = node(edge, 0) << 1, v0 = node(edge, 1) << 1 | 1;
+                            std::uint32_t nu = path(u0, us.data());
+                            std::uint32_t nv = path(v0, vs.data());
+                            if (us[nu] == vs[nv]) {
+                                const std::uint32_t min = nu < nv ? nu : nv;
+                                for (nu -= min, nv -= min; us[nu] != vs[nv]; nu++, nv++)
+                                    ;
+                                const std::uint32_t len = nu + nv + 1;
+                                if (len == proofSize) {
+                                    solution(us.data(), nu, vs.data(), nv, cycles);
+                                    found = true;
+                                }
+                            } else if (nu < nv) {
+                                while (nu--)
+                                    cuckoo.set(us[nu + 1], us[nu]);
+                                cuckoo.set(u0, v0);
+                            } else {
+                                while (nv--)
+                                    cuckoo.set(vs[nv + 1], vs[nv]);
+                                cuckoo.set(v0, u0);
+                            }
+                        }
+                        return found;
+                    }
+
+                private:
+                    std::uint8_t edgeBits;
+                    std::uint32_t edgemask;
+                    size_t threads;
+                    ctpl::thread_pool& pool;
+                    std::uint32_t nTrims;
+                    const Epoch* epoch;
+                    std::uint64_t start_epoch = 0;
+                    double min_gain;
+                    crypto::siphash_keys sip_keys;
+                    std::uint8_t proofSize = 0;
+
+                    std::size_t words;
+                    std::uint64_t* alive;
+                    std::uint64_t* twice_bits;
+                    util::PageBacking alive_backing;
+                    util::PageBacking twice_backing;
+                    std::vector<std::uint64_t> counts;
+
+                    std::vector<std::uint32_t> edges;
+                    NodeMap cuckoo;
+            };
+        }
+
+        std::unique_ptr<Solver::Impl> make_lean_solver(
+                std::uint8_t edgeBits,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                const SolverOptions& options)
+        {
+            return std::make_unique<lean_solver>(edgeBits, threads, pool, options);
+        }
+
+        std::uint64_t lean_solver_bytes(std::uint8_t edgeBits)
+        {
+            check_edgebits(edgeBits);
+            return alivebytes(edgeBits) + twicebytes(edgeBits) + searchbytes(edgeBits);
+        }
+    }
+}
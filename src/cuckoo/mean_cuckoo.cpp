@@ -30,15 +30,19 @@
  * this exception statement from all source files in the program, then
  * also delete it here.
  */
-#include "bitcash/cuckoo/mean_cuckoo.h"
+#include "solver_impl.h"
 
 #include "bitcash/crypto/siphash.h"
-#include "bitcash/crypto/siphashxN.h"
 #include "bitcash/blake2/blake2.h"
+#include "bitcash/util/memory.hpp"
+#include "bitcash/cuckoo/tuning.h"
 #include <sstream>
-#include <bitset>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <cstdint>
 #undef min
@@ -49,6 +53,7 @@
 // The node bits are logically split into 3 groups:
 // XBITS 'X' bits (most significant), YBITS 'Y' bits, and ZBITS 'Z' bits (least significant)
 // Here we have the default XBITS=YBITS=7, ZBITS=15 summing to EDGEBITS=29
+// YBITS may also exceed XBITS, trading Z bits for more Y buckets per row
 // nodebits   XXXXXXX YYYYYYY ZZZZZZZZZZZZZZZ
 // bit%10     8765432 1098765 432109876543210
 // bit/10     2222222 2111111 111110000000000
@@ -67,13 +72,45 @@
 // and directly count YZ values in a cache friendly 32KB.
 // A final pair of compression rounds remap YZ values from 15 into 11 bits.
 
-#ifdef __AVX2__
+// This file is compiled once per instruction set (see the mean_cuckoo_*.cpp
+// wrappers) and the variant to run is picked at runtime in solver.cpp.
+// The wrappers name the target in BITCASH_CUCKOO_TARGET instead of building
+// with -m flags, so only the code from here on is compiled for it. Whatever
+// the headers above define, the standard library included, is compiled for
+// the baseline in every variant and any copy the linker keeps runs anywhere.
+// g++ leaves the __AVX2__ style macros alone at a target pragma, so the
+// wrappers set NSIPHASH to the lanes of their kernels as well.
+#ifndef BITCASH_CUCKOO_ISA
+#define BITCASH_CUCKOO_ISA generic
+#endif
+
+#ifdef BITCASH_CUCKOO_TARGET
+#define BITCASH_CUCKOO_PRAGMA(x) _Pragma(#x)
+#define BITCASH_CUCKOO_TARGET_PRAGMA(isa) BITCASH_CUCKOO_PRAGMA(GCC target(isa))
+BITCASH_CUCKOO_TARGET_PRAGMA(BITCASH_CUCKOO_TARGET)
+#endif
+
+#include "bitcash/crypto/siphashxN.h"
+
+#if defined(__AVX512F__)
+
+#ifndef NSIPHASH
+#define NSIPHASH 16
+#endif
+
+#elif defined(__AVX2__)
 
 
 #ifndef NSIPHASH
 #define NSIPHASH 8
 #endif
 
+#elif defined(__SSE4_1__)
+
+#ifndef NSIPHASH
+#define NSIPHASH 4
+#endif
+
 #else
 
 #ifndef NSIPHASH
@@ -86,21 +123,35 @@ namespace bitcash
 {
     namespace cuckoo
     {
+        // each variant lives in a namespace of its own so the template
+        // instantiations compiled with different flags cannot be mixed up
+        namespace BITCASH_CUCKOO_ISA
+        {
+#if NSIPHASH == 16
+        const Isa COMPILED_ISA = Isa::AVX512;
+#elif NSIPHASH == 8
+        const Isa COMPILED_ISA = Isa::AVX2;
+#elif NSIPHASH == 4
+        const Isa COMPILED_ISA = Isa::SSE41;
+#else
+        const Isa COMPILED_ISA = Isa::Scalar;
+#endif
+
         const int MAXPATHLEN = 8192;
         /** Minimum number of edge bits for cuckoo miner - block.nEdgeBits value */
         const std::uint16_t MIN_EDGE_BITS = 16;
         /** Maximum number of edge bits for cuckoo miner - block.nEdgeBits value */
         const std::uint16_t MAX_EDGE_BITS = 31;
 
-        // for p close to 0, Pr(X>=k) < e^{-n*p*eps^2} where k=n*p*(1+eps)
-        // see https://en.wikipedia.org/wiki/Binomial_distribution#Tail_bounds
-        // eps should be at least 1/sqrt(n*p/64)
-        // to give negligible bad odds of e^-64.
-
-        // 1/32 reduces odds of overflowing z bucket on 2^30 nodes to 2^14*e^-32
-        // (less than 1 in a billion) in theory. not so in practice (fails first at mean30 -n 1549)
-#ifndef BIGEPS
-#define BIGEPS 5 / 64
+        // the edges of a bucket holding n on average are close to normal with
+        // a deviation of sqrt(n), see
+        // https://en.wikipedia.org/wiki/Binomial_distribution#Normal_approximation
+        // a fixed fraction of headroom (it used to be 5/64) is 20 deviations
+        // for 2^16 edges but only 5 for 2^12, so buckets get BIGSIGMAS
+        // deviations instead. 6 leaves odds of about e^-18 per bucket, and
+        // a bucket that overflows anyway drops its graph to the lean engine.
+#ifndef BIGSIGMAS
+#define BIGSIGMAS 6
 #endif
 
         // 184/256 is safely over 1-e(-1) ~ 0.63 trimming fraction
@@ -108,6 +159,12 @@ namespace bitcash
 #define TRIMFRAC256 184
 #endif
 
+        // slots the trim rounds prefetch degree counters ahead unless the
+        // options or the tuned profile say otherwise. a round's counters hit
+        // at random while the slots are read in order, so a few lines in
+        // flight hide most of an L2 miss.
+        const std::uint32_t PREFETCH_DISTANCE = 16;
+
         // convenience function for extracting siphash keys from header
         void setHeader(const char *header, const std::uint32_t headerlen, crypto::siphash_keys *keys)
         {
@@ -116,42 +173,91 @@ namespace bitcash
             crypto::setkeys(keys, hdrkey);
         }
 
+        // Sense reversing barrier between trim rounds. Waiters spin on the
+        // generation counter for a bounded number of iterations, since rounds
+        // are short and a futex sleep/wakeup per round adds up, then fall back
+        // to sleeping on the condition variable.
         class Barrier
         {
             public:
-                explicit Barrier(std::size_t threadsIn) : threads(threadsIn),
+                Barrier(std::size_t threadsIn, std::uint32_t spinsIn) : threads(threadsIn),
+                spins(spinsIn),
                 nCount(threadsIn),
-                nGeneration(0)
+                nGeneration(0),
+                nSleepers(0)
             {
             }
 
                 void Wait()
                 {
-                    std::unique_lock<std::mutex> lLock{mMutex};
-                    auto lGen = nGeneration;
-                    if (!--nCount) {
-                        nGeneration++;
-                        nCount = threads;
-                        cv.notify_all();
-                    } else {
-                        cv.wait(lLock, [this, lGen] { return lGen != nGeneration; });
+                    Wait([] {});
+                }
+
+                // completion runs on the last thread to arrive before any
+                // thread is released, so a decision it takes is seen by all
+                template <typename Completion>
+                void Wait(Completion&& completion)
+                {
+                    const std::uint32_t lGen = nGeneration.load(std::memory_order_acquire);
+                    if (nCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        nCount.store(threads, std::memory_order_relaxed);
+                        completion();
+                        nGeneration.store(lGen + 1);
+                        if (nSleepers.load()) {
+                            std::lock_guard<std::mutex> lLock{mMutex};
+                            cv.notify_all();
+                        }
+                        return;
                     }
+
+                    for (std::uint32_t i = 0; i < spins; i++) {
+                        if (nGeneration.load(std::memory_order_acquire) != lGen) {
+                            return;
+                        }
+                        pause();
+                    }
+
+                    nSleepers.fetch_add(1);
+                    {
+                        std::unique_lock<std::mutex> lLock{mMutex};
+                        cv.wait(lLock, [this, lGen] { return nGeneration.load() != lGen; });
+                    }
+                    nSleepers.fetch_sub(1);
                 }
 
             private:
+                static void pause()
+                {
+#if defined(__x86_64__) || defined(__i386__)
+                    __builtin_ia32_pause();
+#else
+                    std::this_thread::yield();
+#endif
+                }
+
+                // the counters every thread writes sit on cache lines of their own
+                const std::uint32_t threads;
+                const std::uint32_t spins;
+                char pad0[64];
+                std::atomic<std::uint32_t> nCount;
+                char pad1[64 - sizeof(std::atomic<std::uint32_t>)];
+                std::atomic<std::uint32_t> nGeneration;
+                char pad2[64 - sizeof(std::atomic<std::uint32_t>)];
+                std::atomic<std::uint32_t> nSleepers;
                 std::mutex mMutex;
                 std::condition_variable cv;
-                std::size_t threads;
-                std::size_t nCount;
-                std::size_t nGeneration;
         };
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS>
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
             struct Params {
                 // prepare params for algorithm
                 const static std::uint32_t EDGEMASK = (1LU << EDGEBITS) - 1U;
 
-                const static std::uint8_t YBITS = XBITS;
+                // the matrix is NX by NX buckets, YBITS only splits a row into
+                // the per thread Y buckets, so a larger YBITS means smaller Z
+                // counters without more or smaller matrix buckets
+                static_assert(YBITS >= XBITS, "YBITS must be at least XBITS");
+
                 const static std::uint32_t NX = 1 << XBITS;
                 const static std::uint32_t XMASK = NX - 1;
 
@@ -173,7 +279,8 @@ namespace bitcash
                 const static std::uint32_t NYZ1 = 1 << YZ1BITS;
                 const static std::uint32_t YZ1MASK = NYZ1 - 1;
 
-                const static std::uint32_t Z1BITS = YZ1BITS - YBITS;
+                // renamed ids are handed out in NX chunks, one per bucket of the row
+                const static std::uint32_t Z1BITS = YZ1BITS - XBITS;
                 const static std::uint32_t NZ1 = 1 << Z1BITS;
                 const static std::uint32_t Z1MASK = NZ1 - 1;
 
@@ -181,7 +288,7 @@ namespace bitcash
                 const static std::uint32_t NYZ2 = 1 << YZ2BITS;
                 const static std::uint32_t YZ2MASK = NYZ2 - 1;
 
-                const static std::uint32_t Z2BITS = YZ2BITS - YBITS;
+                const static std::uint32_t Z2BITS = YZ2BITS - XBITS;
                 const static std::uint32_t NZ2 = 1 << Z2BITS;
                 const static std::uint32_t Z2MASK = NZ2 - 1;
 
@@ -207,22 +314,44 @@ namespace bitcash
                 const static std::uint32_t NNONYZ = 1 << NONYZBITS;
 
                 const static std::uint32_t NTRIMMEDZ = NZ * TRIMFRAC256 / 256;
-                const static std::uint32_t ZBUCKETSLOTS = NZ + NZ * BIGEPS;
+                // edges in a matrix bucket, one for each pair of X values
+                const static std::uint32_t CELLBITS = EDGEBITS - 2 * XBITS;
+                const static std::uint32_t NCELL = 1 << CELLBITS;
+
+                // BIGSIGMAS deviations over 2^bits, sqrt(2) taken as 363/256
+                static constexpr std::uint32_t headroom(const std::uint32_t bits)
+                {
+                    return bits & 1 ? (BIGSIGMAS * 363 + 255) / 256 << bits / 2 : BIGSIGMAS << bits / 2;
+                }
+
+                // with one or two buckets a row the rename tables at the end
+                // of a bucket take more words than it has edges, the edges
+                // left beside them once compressed have had NCELL / 64
+                const static std::uint32_t RENAMEWORDS = 2 * NZ2 + 2 * (COMPRESSROUND ? NZ1 : 0);
+                const static std::uint32_t ZBUCKETSLOTS = std::max(NCELL + headroom(CELLBITS), RENAMEWORDS + NCELL / 64);
                 const static std::uint32_t ZBUCKETSIZE = ZBUCKETSLOTS * BIGSIZE0;
-                const static std::uint32_t TBUCKETSIZE = ZBUCKETSLOTS * BIGSIZE;
+                const static std::uint32_t TBUCKETSLOTS = std::max(NZ + headroom(ZBITS), RENAMEWORDS);
+                const static std::uint32_t TBUCKETSIZE = TBUCKETSLOTS * BIGSIZE;
 
                 const static bool NEEDSYNC = BIGSIZE0 == 4 && EDGEBITS > 27;
 
+                // with SolverOptions::index_edges every bucket has a lane beside
+                // it holding the nonce of each of its slots, no slot is under
+                // 4 bytes so it never needs more slots than these
+                const static bool INDEXABLE = EDGEBITS <= 27;
+                const static std::uint32_t LANESIZE = ZBUCKETSLOTS * sizeof(std::uint32_t);
+                const static std::uint32_t TLANESIZE = TBUCKETSLOTS * sizeof(std::uint32_t);
+
                 // grow with cube root of size, hardly affected by trimming
                 // const static std::uint32_t CUCKOO_SIZE = 2 * NX * NYZ2;
                 const static std::uint32_t CUCKOO_SIZE = 2 * NX * NYZ2;
             };
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint32_t BUCKETSIZE>
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS, std::uint32_t BUCKETSIZE>
             struct zbucket {
-                using P = Params<EDGEBITS, XBITS>;
+                using P = Params<EDGEBITS, XBITS, YBITS>;
                 std::uint32_t size;
-                const static std::uint32_t RENAMESIZE = 2 * P::NZ2 + 2 * (P::COMPRESSROUND ? P::NZ1 : 0);
+                const static std::uint32_t RENAMESIZE = P::RENAMEWORDS;
                 union alignas(16) {
                     std::uint8_t bytes[BUCKETSIZE];
                     struct {
@@ -236,77 +365,205 @@ namespace bitcash
                 std::uint32_t setsize(std::uint8_t const* end)
                 {
                     size = end - bytes;
-                    assert(size <= BUCKETSIZE);
                     return size;
                 }
+                // the size to read up to, kept within the bucket when the one
+                // before it spilled over its size
+                std::uint32_t fill() const
+                {
+                    return size < BUCKETSIZE ? size : BUCKETSIZE;
+                }
             };
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint32_t BUCKETSIZE>
-            using yzbucket = zbucket<EDGEBITS, XBITS, BUCKETSIZE>[Params<EDGEBITS, XBITS>::NY];
+        // a thread's row sorted on Y, ending in a spare bucket for the last
+        // one to spill into rather than the next thread's row
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS, std::uint32_t BUCKETSIZE>
+            using yzbucket = zbucket<EDGEBITS, XBITS, YBITS, BUCKETSIZE>[Params<EDGEBITS, XBITS, YBITS>::NY + 1];
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint32_t BUCKETSIZE>
-            using matrix = yzbucket<EDGEBITS, XBITS, BUCKETSIZE>[Params<EDGEBITS, XBITS>::NX];
+        // a matrix row, one bucket per X of the other side
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS, std::uint32_t BUCKETSIZE>
+            using xzbucket = zbucket<EDGEBITS, XBITS, YBITS, BUCKETSIZE>[Params<EDGEBITS, XBITS, YBITS>::NX];
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint32_t BUCKETSIZE>
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS, std::uint32_t BUCKETSIZE>
+            using matrix = xzbucket<EDGEBITS, XBITS, YBITS, BUCKETSIZE>[Params<EDGEBITS, XBITS, YBITS>::NX];
+
+#ifdef __GNUC__
+#define likely(x) __builtin_expect((x) != 0, 1)
+#define unlikely(x) __builtin_expect((x), 0)
+#else 
+#define likely(x) (x)
+#define unlikely(x) (x)
+#endif
+
+        // write positions into NCOLS buckets of a row, or of a column when
+        // NCOLS is NX and the rows are the matrix. rows hold NROW buckets.
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS, std::uint32_t BUCKETSIZE, std::uint32_t NCOLS, std::uint32_t NROW = NCOLS>
             struct indexer {
-                using P = Params<EDGEBITS, XBITS>;
+                using P = Params<EDGEBITS, XBITS, YBITS>;
+                using row = zbucket<EDGEBITS, XBITS, YBITS, BUCKETSIZE>[NROW];
 
-                offset_t index[P::NX];
+                offset_t index[NCOLS];
+                offset_t end[NCOLS]; // the last write position of each bucket
+                bool spilled = false; // a bucket ran out of room or was written past its end
 
                 void matrixv(const std::uint32_t y)
                 {
-                    const yzbucket<EDGEBITS, XBITS, BUCKETSIZE>* foo = 0;
-                    for (std::uint32_t x = 0; x < P::NX; x++)
+                    const row* foo = 0;
+                    for (std::uint32_t x = 0; x < NCOLS; x++) {
                         index[x] = foo[x][y].bytes - (std::uint8_t*)foo;
+                        end[x] = index[x] + BUCKETSIZE - sizeof(std::uint64_t);
+                    }
                 }
-                offset_t storev(yzbucket<EDGEBITS, XBITS, BUCKETSIZE>* buckets, const std::uint32_t y)
+                offset_t storev(row* buckets, const std::uint32_t y)
                 {
                     std::uint8_t const* base = (std::uint8_t*)buckets;
                     offset_t sumsize = 0;
-                    for (std::uint32_t x = 0; x < P::NX; x++) {
-                        sumsize += buckets[x][y].setsize(base + index[x]);
+                    for (std::uint32_t x = 0; x < NCOLS; x++) {
+                        const std::uint32_t size = buckets[x][y].setsize(base + index[x]);
+                        spilled |= size > BUCKETSIZE;
+                        sumsize += size;
                     }
                     return sumsize;
                 }
                 void matrixu(const std::uint32_t x)
                 {
-                    const yzbucket<EDGEBITS, XBITS, BUCKETSIZE>* foo = 0;
-                    for (std::uint32_t y = 0; y < P::NY; y++)
+                    const row* foo = 0;
+                    for (std::uint32_t y = 0; y < NCOLS; y++) {
                         index[y] = foo[x][y].bytes - (std::uint8_t*)foo;
+                        end[y] = index[y] + BUCKETSIZE - sizeof(std::uint64_t);
+                    }
                 }
-                offset_t storeu(yzbucket<EDGEBITS, XBITS, BUCKETSIZE>* buckets, const std::uint32_t x)
+                offset_t storeu(row* buckets, const std::uint32_t x)
                 {
                     std::uint8_t const* base = (std::uint8_t*)buckets;
                     offset_t sumsize = 0;
-                    for (std::uint32_t y = 0; y < P::NY; y++)
-                        sumsize += buckets[x][y].setsize(base + index[y]);
+                    for (std::uint32_t y = 0; y < NCOLS; y++) {
+                        const std::uint32_t size = buckets[x][y].setsize(base + index[y]);
+                        spilled |= size > BUCKETSIZE;
+                        sumsize += size;
+                    }
                     return sumsize;
                 }
+                // whether bucket x has room to move on by size. a full bucket
+                // keeps its last write position, so the slots that no longer
+                // fit are overwritten there instead of running into the next
+                // bucket, which in a column is another thread's.
+                bool room(const std::uint32_t x, const std::uint32_t size)
+                {
+                    if (likely(index[x] + size <= end[x]))
+                        return true;
+                    spilled = true;
+                    return false;
+                }
             };
-#ifdef __GNUC__
-#define likely(x) __builtin_expect((x) != 0, 1)
-#define unlikely(x) __builtin_expect((x), 0)
-#else 
-#define likely(x) (x)
-#define unlikely(x) (x)
+#if NSIPHASH == 8
+        // lane indices that move the lanes set in a mask to the front, for
+        // compacting a vector without the avx-512 compress store
+        struct packtable
+        {
+            alignas(32) std::uint32_t lanes[256][8];
+
+            packtable()
+            {
+                for (std::uint32_t mask = 0; mask < 256; mask++) {
+                    std::uint32_t n = 0;
+                    for (std::uint32_t i = 0; i < 8; i++)
+                        if (mask >> i & 1)
+                            lanes[mask][n++] = i;
+                    while (n < 8)
+                        lanes[mask][n++] = 0;
+                }
+            }
+        };
+
+        static const packtable PACK8;
+#endif
+
+        // Software write combining for the scatter into NCOLS buckets. The
+        // slots of each bucket gather in a cache line of staging and full
+        // lines go out with non-temporal stores, so the scatter neither reads
+        // the bucket lines for ownership nor evicts the rows being read. The
+        // lines at either end of a bucket may be shared with a neighbour and
+        // are copied with plain stores.
+        template <typename offset_t, std::uint32_t NCOLS>
+            struct wcbuffer {
+                const static std::uint32_t LINE = 64;
+                // slots are staged as 8 bytes, the part of one that runs past
+                // the end of the line lands in the spare bytes
+                const static std::uint32_t STRIDE = LINE + sizeof(std::uint64_t);
+
+                std::uint8_t lines[NCOLS * STRIDE];
+                std::uint8_t head[NCOLS]; // first byte of each line that is ours
+                std::uint64_t streamed = 0; // bytes written with non-temporal stores
+
+                // start staging at the write positions an indexer just set
+                void begin(const offset_t index[])
+                {
+                    for (std::uint32_t x = 0; x < NCOLS; x++)
+                        head[x] = index[x] % LINE;
+                }
+
+                // stages slot at index[x] and moves it on by size, 0 to drop the slot
+                void put(std::uint8_t const* base, offset_t index[], const std::uint32_t x, const std::uint64_t slot, const std::uint32_t size)
+                {
+                    std::uint8_t* line = lines + x * STRIDE;
+                    const std::uint32_t off = index[x] % LINE;
+                    memcpy(line + off, &slot, sizeof(slot));
+                    index[x] += size;
+                    if (unlikely(off + size >= LINE)) {
+                        flush(base + index[x] - size - off, line, head[x]);
+                        memcpy(line, line + LINE, sizeof(std::uint64_t));
+                        head[x] = 0;
+                    }
+                }
+
+                // writes out the partial lines left and orders the streamed
+                // ones before the round barrier
+                void end(std::uint8_t const* base, const offset_t index[])
+                {
+                    for (std::uint32_t x = 0; x < NCOLS; x++) {
+                        const std::uint32_t off = index[x] % LINE;
+                        if (off > head[x])
+                            memcpy((std::uint8_t*)base + index[x] - off + head[x], lines + x * STRIDE + head[x], off - head[x]);
+                    }
+                    _mm_sfence();
+                }
+
+                void flush(std::uint8_t const* dst, std::uint8_t const* line, const std::uint32_t from)
+                {
+                    if (from) {
+                        memcpy((std::uint8_t*)dst + from, line + from, LINE - from);
+                        return;
+                    }
+#if NSIPHASH == 16
+                    _mm512_stream_si512((__m512i*)dst, _mm512_loadu_si512(line));
+#elif NSIPHASH == 8
+                    _mm256_stream_si256((__m256i*)dst, _mm256_loadu_si256((const __m256i*)line));
+                    _mm256_stream_si256((__m256i*)(dst + 32), _mm256_loadu_si256((const __m256i*)(line + 32)));
+#else
+                    for (std::uint32_t i = 0; i < LINE; i += 16)
+                        _mm_stream_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(line + i)));
 #endif
+                    streamed += LINE;
+                }
+            };
 
         // break circular reference with forward declaration
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
             class edgetrimmer;
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
             class solver_ctx;
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
-            void etworker(edgetrimmer<offset_t, EDGEBITS, XBITS>* et, std::uint32_t id)
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            void etworker(edgetrimmer<offset_t, EDGEBITS, XBITS, YBITS>* et, std::uint32_t id)
             {
                 et->trimmer(id);
             }
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
-            void matchworker(solver_ctx<offset_t, EDGEBITS, XBITS>* solver, std::uint32_t id)
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            void matchworker(solver_ctx<offset_t, EDGEBITS, XBITS, YBITS>* solver, std::uint32_t id)
             {
                 solver->matchUnodes(id);
             }
@@ -317,33 +574,59 @@ namespace bitcash
                 return a > b ? a : b;
             }
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS>
-            using zbucket8 = std::uint8_t[2 * cmax(Params<EDGEBITS, XBITS>::NZ, Params<EDGEBITS, XBITS>::NYZ1)];
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            using zbucket8 = std::uint8_t[2 * cmax(Params<EDGEBITS, XBITS, YBITS>::NZ, Params<EDGEBITS, XBITS, YBITS>::NYZ1)];
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS>
-            using zbucket16 = std::uint16_t[Params<EDGEBITS, XBITS>::NTRIMMEDZ];
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            using zbucket16 = std::uint16_t[Params<EDGEBITS, XBITS, YBITS>::NTRIMMEDZ];
 
-        template <std::uint8_t EDGEBITS, std::uint8_t XBITS>
-            using zbucket32 = std::uint32_t[Params<EDGEBITS, XBITS>::NTRIMMEDZ];
+        template <std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            using zbucket32 = std::uint32_t[Params<EDGEBITS, XBITS, YBITS>::NTRIMMEDZ];
 
         // maintains set of trimmable edges
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
             class edgetrimmer
             {
                 public:
-                    using P = Params<EDGEBITS, XBITS>;
-                    using zbucket8P = std::uint8_t[2 * cmax(Params<EDGEBITS, XBITS>::NZ, Params<EDGEBITS, XBITS>::NYZ1)];
-                    using zbucket16P = zbucket16<EDGEBITS, XBITS>;
-                    using zbucket32P = zbucket32<EDGEBITS, XBITS>;
-                    using zbucketZ = zbucket<EDGEBITS, XBITS, P::ZBUCKETSIZE>;
-                    using yzbucketZ = yzbucket<EDGEBITS, XBITS, P::ZBUCKETSIZE>;
-                    using yzbucketT = yzbucket<EDGEBITS, XBITS, P::TBUCKETSIZE>;
-                    using indexerZ = indexer<offset_t, EDGEBITS, XBITS, P::ZBUCKETSIZE>;
-                    using indexerT = indexer<offset_t, EDGEBITS, XBITS, P::TBUCKETSIZE>;
+                    using P = Params<EDGEBITS, XBITS, YBITS>;
+                    using zbucket8P = std::uint8_t[2 * cmax(Params<EDGEBITS, XBITS, YBITS>::NZ, Params<EDGEBITS, XBITS, YBITS>::NYZ1)];
+                    using zbucket16P = zbucket16<EDGEBITS, XBITS, YBITS>;
+                    using zbucket32P = zbucket32<EDGEBITS, XBITS, YBITS>;
+                    using zbucketZ = zbucket<EDGEBITS, XBITS, YBITS, P::ZBUCKETSIZE>;
+                    using xzbucketZ = xzbucket<EDGEBITS, XBITS, YBITS, P::ZBUCKETSIZE>;
+                    using yzbucketT = yzbucket<EDGEBITS, XBITS, YBITS, P::TBUCKETSIZE>;
+                    using indexerZ = indexer<offset_t, EDGEBITS, XBITS, YBITS, P::ZBUCKETSIZE, P::NX>;
+                    using indexerT = indexer<offset_t, EDGEBITS, XBITS, YBITS, P::TBUCKETSIZE, P::NY, P::NY + 1>;
+                    using laneZ = zbucket<EDGEBITS, XBITS, YBITS, P::LANESIZE>;
+                    using xzlaneZ = xzbucket<EDGEBITS, XBITS, YBITS, P::LANESIZE>;
+                    using yzlaneT = yzbucket<EDGEBITS, XBITS, YBITS, P::TLANESIZE>;
+                    using indexerL = indexer<offset_t, EDGEBITS, XBITS, YBITS, P::LANESIZE, P::NX>;
+                    using indexerTL = indexer<offset_t, EDGEBITS, XBITS, YBITS, P::TLANESIZE, P::NY, P::NY + 1>;
+                    using wcbufferZ = wcbuffer<offset_t, P::NX>;
 
                     crypto::siphash_keys sip_keys;
-                    yzbucketZ* buckets;
+                    xzbucketZ* buckets;
                     yzbucketT* tbuckets;
+                    util::PageBacking buckets_backing;
+                    util::PageBacking tbuckets_backing;
+                    // nonce lanes of the matrix and of the per thread buckets,
+                    // written in step with the slots from genVnodes on. null
+                    // unless SolverOptions::index_edges.
+                    xzlaneZ* lanes = nullptr;
+                    yzlaneT* tlanes = nullptr;
+                    util::PageBacking lanes_backing;
+                    // per thread staging of the matrix writes, null unless
+                    // SolverOptions::stream_stores. rounds writing no more than
+                    // stream_min bytes use plain stores, the next round finds
+                    // their lines in the last level cache.
+                    wcbufferZ* tstage = nullptr;
+                    std::uint64_t stream_min = 0;
+                    // with SolverOptions::fuse_degrees genUnodes marks every U
+                    // node it emits an edge for, word 2i the nodes seen once and
+                    // word 2i + 1 those seen again for nodes 64i..64i + 63.
+                    // genVnodes filters on the second word and clears its row.
+                    std::atomic<std::uint64_t>* nodebits = nullptr;
+                    util::PageBacking nodebits_backing;
                     zbucket32P* tedges;
                     zbucket16P* tzs;
                     zbucket8P* tdegs;
@@ -353,44 +636,221 @@ namespace bitcash
                     std::uint32_t nTrims;
                     Barrier* barry;
 
-                    using BIGTYPE0 = offset_t;
-
-                    void touch(std::uint8_t* p, const offset_t n)
+                    // next matrix row to hand out, one counter per trim round
+                    // plus one for recovery, each on a cache line of its own
+                    struct RowCounter
                     {
-                        for (offset_t i = 0; i < n; i += 4096)
-                            *(std::uint32_t*)(p + i) = 0;
-                    }
+                        std::atomic<std::uint32_t> next;
+                        char pad[64 - sizeof(std::atomic<std::uint32_t>)];
+                    };
+                    RowCounter* rows;
+
+                    // graphs started under an older epoch are abandoned at the next barrier
+                    const Epoch* epoch;
+                    std::uint64_t start_epoch = 0;
+                    bool aborted = false;
+                    // a bucket ran out of room, the graph is abandoned at the
+                    // next barrier as well
+                    std::atomic<bool> overflowed{false};
+
+                    // trimming plan, decided at the round barriers from the live
+                    // edge counts. the compress pair starts at compressround,
+                    // the final rename pair at finalround, 0 until chosen.
+                    double min_gain;
+                    std::uint32_t compressround = 0;
+                    std::uint32_t finalround = 0;
+                    offset_t lastcount = 0;
+                    offset_t live = 0; // edges left by the last round, counted at its barrier
+
+                    // slots the trim rounds look ahead to prefetch the degree
+                    // counters their reads will hit, 0 for none
+                    std::uint32_t prefetch_distance;
+
+                    // time each round took, taken at its barrier
+                    std::vector<double> round_seconds;
+                    std::chrono::steady_clock::time_point round_start;
+
+                    using BIGTYPE0 = offset_t;
 
                     edgetrimmer(
                             ctpl::thread_pool& poolIn,
                             size_t threadsIn,
-                            const std::uint32_t nTrimsIn) : pool{poolIn}, nTrims{nTrimsIn}
+                            const std::uint32_t nTrimsIn,
+                            const SolverOptions& options) : pool{poolIn}, nTrims{nTrimsIn}, epoch{options.epoch}, min_gain{options.min_trim_gain},
+                        prefetch_distance(options.prefetch_distance < 0 ? PREFETCH_DISTANCE : options.prefetch_distance),
+                        round_seconds(nTrimsIn + 2)
                     {                    
 
+                        if (options.index_edges && !P::INDEXABLE) {
+                            throw std::runtime_error{"index_edges needs EDGEBITS of 27 or less"};
+                        }
+
                         threads = threadsIn;
 
-                        buckets = new yzbucketZ[P::NX];
-                        touch((std::uint8_t*)buckets, sizeof(zbucket<EDGEBITS, XBITS, P::ZBUCKETSIZE>) * P::NX * P::NY);
-                        tbuckets = new yzbucketT[threads];
-                        touch((std::uint8_t*)tbuckets, threads * sizeof(yzbucketT));
+                        buckets = static_cast<xzbucketZ*>(util::alloc_large(bucketsbytes(), buckets_backing, options.numa_node));
+                        tbuckets = static_cast<yzbucketT*>(util::alloc_large(tbucketsbytes(), tbuckets_backing, options.numa_node));
+                        if (options.index_edges) {
+                            lanes = static_cast<xzlaneZ*>(util::alloc_large(lanesbytes(threads), lanes_backing, options.numa_node));
+                            tlanes = reinterpret_cast<yzlaneT*>(lanes + P::NX);
+                        }
 
                         tedges = new zbucket32P[threads];
                         tdegs = new zbucket8P[threads];
                         tzs = new zbucket16P[threads];
                         tcounts = new offset_t[threads];
+                        if (options.stream_stores) {
+                            tstage = new wcbufferZ[threads];
+                            stream_min = ReadCacheSizes().l3;
+                        }
+                        if (options.fuse_degrees) {
+                            nodebits = static_cast<std::atomic<std::uint64_t>*>(util::alloc_large(nodebitsbytes(), nodebits_backing, options.numa_node));
+                            memset((void*)nodebits, 0, nodebitsbytes());
+                        }
+
+                        // spinning only pays off while every trimming thread has a core
+                        const bool oversubscribed = threads > std::thread::hardware_concurrency();
+                        barry = new Barrier(threads, oversubscribed ? 0 : options.barrier_spins);
+                        rows = new RowCounter[nTrims + 1];
 
-                        barry = new Barrier(threads);
+                        prefault();
                     }
                     ~edgetrimmer()
                     {
-                        delete[] buckets;
-                        delete[] tbuckets;
+                        util::free_large(buckets, bucketsbytes(), buckets_backing);
+                        util::free_large(tbuckets, tbucketsbytes(), tbuckets_backing);
+                        if (lanes) {
+                            util::free_large(lanes, lanesbytes(threads), lanes_backing);
+                        }
+                        if (nodebits) {
+                            util::free_large(nodebits, nodebitsbytes(), nodebits_backing);
+                        }
                         delete[] tedges;
                         delete[] tdegs;
                         delete[] tzs;
                         delete[] tcounts;
+                        delete[] tstage;
                         delete barry;
+                        delete[] rows;
+                    }
+                    // writes into the matrix stop at the end of each bucket,
+                    // only the thread rows end in a spare bucket to spill into
+                    std::size_t bucketsbytes() const
+                    {
+                        return sizeof(xzbucketZ) * P::NX;
+                    }
+
+                    std::size_t tbucketsbytes() const
+                    {
+                        return sizeof(yzbucketT) * threads;
+                    }
+
+                    // the matrix lanes followed by those of every thread
+                    static std::size_t lanesbytes(const std::size_t threads)
+                    {
+                        return sizeof(xzlaneZ) * P::NX + sizeof(yzlaneT) * threads;
+                    }
+
+                    static std::size_t nodebitsbytes()
+                    {
+                        return ((std::size_t)P::NX << P::YZBITS) / 4;
+                    }
+
+                    // U nodes genUnodes has yet to mark. hashing keeps the cpu
+                    // too busy to have more than a mark or two miss the cache at
+                    // once, so they are marked in batches prefetched up front.
+                    struct markqueue
+                    {
+                        const static std::uint32_t BATCH = 64;
+                        std::uint32_t n = 0;
+                        std::uint32_t nodes[BATCH];
+                    };
+
+                    // counts one more edge on U node ux, uyz
+                    void mark(markqueue& q, const std::uint32_t ux, const std::uint32_t uyz)
+                    {
+                        q.nodes[q.n++] = ux << P::YZBITS | uyz;
+                        if (unlikely(q.n == markqueue::BATCH))
+                            marks(q);
+                    }
+
+                    // applies the queued marks. only one thread trims without
+                    // atomics, and never branches on a mark it just read.
+                    void marks(markqueue& q)
+                    {
+                        for (std::uint32_t i = 0; i < q.n; i++)
+                            prefetch(nodebits + 2 * (q.nodes[i] >> 6));
+                        for (std::uint32_t i = 0; i < q.n; i++) {
+                            std::atomic<std::uint64_t>* words = nodebits + 2 * (q.nodes[i] >> 6);
+                            const std::uint64_t bit = 1ULL << (q.nodes[i] & 63);
+                            if (threads == 1) {
+                                const std::uint64_t seen = words[0].load(std::memory_order_relaxed);
+                                words[0].store(seen | bit, std::memory_order_relaxed);
+                                words[1].store(words[1].load(std::memory_order_relaxed) | (seen & bit), std::memory_order_relaxed);
+                            } else {
+                                words[1].fetch_or(words[0].fetch_or(bit, std::memory_order_relaxed) & bit, std::memory_order_relaxed);
+                            }
+                        }
+                        q.n = 0;
+                    }
+
+                    // U node ux, uyz has two or more edges
+                    bool twice(const std::uint32_t ux, const std::uint32_t uyz) const
+                    {
+                        const std::uint32_t node = ux << P::YZBITS | uyz;
+                        return nodebits[2 * (node >> 6) + 1].load(std::memory_order_relaxed) >> (node & 63) & 1;
                     }
+
+                    // forget the marks of row ux for the next graph
+                    void unmark(const std::uint32_t ux)
+                    {
+                        const std::size_t row = nodebitsbytes() / P::NX;
+                        memset((std::uint8_t*)nodebits + row * ux, 0, row);
+                    }
+
+                    // fault in the matrix up front, each thread taking a slice
+                    // of the shared buckets plus its own tbuckets
+                    void prefault()
+                    {
+                        auto slice = [this](std::uint32_t t) {
+                            const std::size_t start = bucketsbytes() * t / threads;
+                            const std::size_t end = bucketsbytes() * (t + 1) / threads;
+                            util::prefault((std::uint8_t*)buckets + start, end - start);
+                            util::prefault(tbuckets + t, sizeof(yzbucketT));
+                            if (lanes) {
+                                const std::size_t lanesstart = sizeof(xzlaneZ) * P::NX * t / threads;
+                                const std::size_t lanesend = sizeof(xzlaneZ) * P::NX * (t + 1) / threads;
+                                util::prefault((std::uint8_t*)lanes + lanesstart, lanesend - lanesstart);
+                                util::prefault(tlanes + t, sizeof(yzlaneT));
+                            }
+                        };
+
+                        if (threads == 1) {
+                            slice(0);
+                            return;
+                        }
+
+                        std::vector<std::future<void>> jobs;
+                        for (std::uint32_t t = 0; t < threads; t++) {
+                            jobs.push_back(pool.push([t, &slice](int) { slice(t); }));
+                        }
+
+                        for(auto& j : jobs) {
+                            j.wait();
+                        }
+                    }
+
+                    // whether the buckets dst wrote spilled over, which leaves
+                    // the graph to be dropped. rows that would read spilled
+                    // edges of their own are skipped until then.
+                    template <typename I>
+                        bool spill(const I& dst)
+                        {
+                            if (likely(!dst.spilled))
+                                return false;
+                            overflowed.store(true, std::memory_order_relaxed);
+                            return true;
+                        }
+
                     offset_t count() const
                     {
                         offset_t cnt = 0;
@@ -399,6 +859,49 @@ namespace bitcash
                         return cnt;
                     }
 
+                    // bytes of the matrix written with non-temporal stores
+                    // since trimming started
+                    std::uint64_t streamed() const
+                    {
+                        std::uint64_t bytes = 0;
+                        for (std::uint32_t t = 0; tstage && t < threads; t++)
+                            bytes += tstage[t].streamed;
+                        return bytes;
+                    }
+
+                    // staging of thread id for a round writing bytes to the matrix, if it streams
+                    wcbufferZ* stage(const std::uint32_t id, const std::uint64_t bytes) const
+                    {
+                        return tstage && bytes > stream_min ? tstage + id : nullptr;
+                    }
+
+                    // the slot dist bytes past p, or p itself once that runs past
+                    // end, so reading it never leaves the bucket
+                    template <typename T>
+                        static const T* ahead(const T* p, const T* end, const std::uint32_t dist)
+                        {
+                            return p + dist < end ? p + dist : p;
+                        }
+
+                    static void prefetch(const void* p)
+                    {
+                        _mm_prefetch((const char*)p, _MM_HINT_T0);
+                    }
+
+                    // writes slot to bucket x of dst, through the staging lines
+                    // when there are any
+                    template <typename T>
+                        static void emit(std::uint8_t const* base, indexerZ& dst, wcbufferZ* wc, const std::uint32_t x, const T slot, const std::uint32_t size)
+                        {
+                            const std::uint32_t step = dst.room(x, size) ? size : 0;
+                            if (wc) {
+                                wc->put(base, dst.index, x, slot, step);
+                            } else {
+                                *(T*)(base + dst.index[x]) = slot;
+                                dst.index[x] += step;
+                            }
+                        }
+
 #if NSIPHASH == 8
 
                     template <int x, int i>
@@ -406,6 +909,8 @@ namespace bitcash
                                 std::uint8_t const* base,
                                 std::uint32_t& ux,
                                 indexerZ& dst,
+                                wcbufferZ* wc,
+                                markqueue* mq,
                                 std::uint32_t last[],
                                 const std::uint32_t edge,
                                 __m256i v,
@@ -413,35 +918,109 @@ namespace bitcash
                         {
                             if (!P::NEEDSYNC) {
                                 ux = _mm256_extract_epi32(v, x);
-                                *(std::uint64_t*)(base + dst.index[ux]) = _mm256_extract_epi64(w, i % 4);
-                                dst.index[ux] += P::BIGSIZE0;
+                                const std::uint64_t zz = _mm256_extract_epi64(w, i % 4);
+                                emit<std::uint64_t>(base, dst, wc, ux, zz, P::BIGSIZE0);
+                                if (mq)
+                                    mark(*mq, ux, zz & P::YZMASK);
                             } else {
                                 std::uint32_t zz = _mm256_extract_epi32(w, x);
 
                                 if (i || likely(zz)) {
                                     ux = _mm256_extract_epi32(v, x);
-                                    for (; unlikely(last[ux] + P::NNONYZ <= edge + i); last[ux] += P::NNONYZ, dst.index[ux] += P::BIGSIZE0)
-                                        *(std::uint32_t*)(base + dst.index[ux]) = 0;
-                                    *(std::uint32_t*)(base + dst.index[ux]) = zz;
-                                    dst.index[ux] += P::BIGSIZE0;
+                                    for (; unlikely(last[ux] + P::NNONYZ <= edge + i); last[ux] += P::NNONYZ)
+                                        emit<std::uint32_t>(base, dst, wc, ux, 0, P::BIGSIZE0);
+                                    emit<std::uint32_t>(base, dst, wc, ux, zz, P::BIGSIZE0);
                                     last[ux] = edge + i;
+                                    if (mq)
+                                        mark(*mq, ux, zz & P::YZMASK);
                                 }
                             }
                         }
+#elif NSIPHASH == 4 || NSIPHASH == 16
+
+                    // lanes are stored one by one in edge order, so buckets
+                    // come out the same as with the narrower kernels
+                    void store(
+                            std::uint8_t const* base,
+                            indexerZ& dst,
+                            wcbufferZ* wc,
+                            markqueue* mq,
+                            std::uint32_t last[],
+                            const std::uint32_t edge,
+                            const std::uint32_t ux,
+                            const std::uint64_t zz)
+                    {
+                        if (!P::NEEDSYNC) {
+                            emit<std::uint64_t>(base, dst, wc, ux, zz, P::BIGSIZE0);
+                        } else if (likely((std::uint32_t)zz)) {
+                            for (; unlikely(last[ux] + P::NNONYZ <= edge); last[ux] += P::NNONYZ)
+                                emit<std::uint32_t>(base, dst, wc, ux, 0, P::BIGSIZE0);
+                            emit<std::uint32_t>(base, dst, wc, ux, zz, P::BIGSIZE0);
+                            last[ux] = edge;
+                        } else {
+                            return;
+                        }
+                        if (mq)
+                            mark(*mq, ux, zz & P::YZMASK);
+                    }
 #endif
 
+#if NSIPHASH == 16 || NSIPHASH == 8
+                    // trimedges1 a vector at a time: keeps the 4 byte slots of
+                    // [read, end) whose V node has another edge, swapped to
+                    // the other side, at index. the degrees are gathered and
+                    // the survivors compressed, returns where whole vectors
+                    // ran out. the slots are filtered in place, a store never
+                    // runs past the vector just read.
+                    static std::uint32_t* survivors(std::uint32_t* read, const std::uint32_t* end, const std::uint8_t* degs, std::uint8_t const* base, offset_t& index)
+                    {
+#if NSIPHASH == 16
+                        const __m512i vyzmask = _mm512_set1_epi32(P::YZ1MASK);
+                        const __m512i vff = _mm512_set1_epi32(0xff);
+                        for (; read + 16 <= end; read += 16) {
+                            const __m512i e = _mm512_loadu_si512(read);
+                            const __m512i vyz = _mm512_and_si512(e, vyzmask);
+                            const __m512i deg = _mm512_and_si512(_mm512_i32gather_epi32(vyz, degs, 1), vff);
+                            const __mmask16 keep = _mm512_test_epi32_mask(deg, deg);
+                            const __m512i w = _mm512_or_si512(_mm512_slli_epi32(vyz, P::YZ1BITS), _mm512_srli_epi32(e, P::YZ1BITS));
+                            _mm512_mask_compressstoreu_epi32((void*)(base + index), keep, w);
+                            index += sizeof(std::uint32_t) * __builtin_popcount(keep);
+                        }
+#else
+                        const __m256i vyzmask = _mm256_set1_epi32(P::YZ1MASK);
+                        const __m256i vff = _mm256_set1_epi32(0xff);
+                        for (; read + 8 <= end; read += 8) {
+                            const __m256i e = _mm256_loadu_si256((const __m256i*)read);
+                            const __m256i vyz = _mm256_and_si256(e, vyzmask);
+                            const __m256i deg = _mm256_and_si256(_mm256_i32gather_epi32((const int*)degs, vyz, 1), vff);
+                            const std::uint32_t keep = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(deg, _mm256_setzero_si256()))) & 0xff;
+                            const __m256i w = _mm256_or_si256(_mm256_slli_epi32(vyz, P::YZ1BITS), _mm256_srli_epi32(e, P::YZ1BITS));
+                            _mm256_storeu_si256((__m256i*)(base + index), _mm256_permutevar8x32_epi32(w, _mm256_load_si256((const __m256i*)PACK8.lanes[keep])));
+                            index += sizeof(std::uint32_t) * __builtin_popcount(keep);
+                        }
+#endif
+                        return read;
+                    }
+#endif
+
+                    // appends nonce to the lane of bucket x, or only writes it
+                    // there when size is 0
+                    template <typename L>
+                        static void lanestore(std::uint8_t const* lbase, L& ldst, const std::uint32_t x, const std::uint32_t nonce, const std::uint32_t size = sizeof(std::uint32_t))
+                        {
+                            *(std::uint32_t*)(lbase + ldst.index[x]) = nonce;
+                            ldst.index[x] += ldst.room(x, size) ? size : 0;
+                        }
+
                     void genUnodes(const std::uint32_t id, const std::uint32_t uorv)
                     {
                         std::uint32_t last[P::NX];
 
                         std::uint8_t const* base = (std::uint8_t*)buckets;
                         indexerZ dst;
-                        const std::uint32_t starty = P::NY * id / threads;
-                        const std::uint32_t endy = P::NY * (id + 1) / threads;
-
-                        std::uint32_t edge = starty << P::YZBITS;
-                        std::uint32_t endedge = edge + P::NYZ;
-
+                        wcbufferZ* wc = stage(id, ((std::uint64_t)P::EDGEMASK + 1) * P::BIGSIZE0);
+                        markqueue queue;
+                        markqueue* mq = nodebits ? &queue : nullptr;
 #if NSIPHASH == 8
                         static const __m256i vxmask = {P::XMASK, P::XMASK, P::XMASK, P::XMASK};
                         static const __m256i vyzmask = {P::YZMASK, P::YZMASK, P::YZMASK, P::YZMASK};
@@ -451,19 +1030,72 @@ namespace bitcash
                                 sip_keys.k1 ^ 0x646f72616e646f6dULL,
                                 sip_keys.k0 ^ 0x736f6d6570736575ULL);
                         __m256i v0, v1, v2, v3, v4, v5, v6, v7;
-                        const std::uint32_t e2 = 2 * edge + uorv;
-                        __m256i vpacket0 = _mm256_set_epi64x(e2 + 6, e2 + 4, e2 + 2, e2 + 0);
-                        __m256i vpacket1 = _mm256_set_epi64x(e2 + 14, e2 + 12, e2 + 10, e2 + 8);
+                        __m256i vpacket0, vpacket1, vhi0, vhi1;
                         static const __m256i vpacketinc = {16, 16, 16, 16};
-                        std::uint64_t e1 = edge;
-                        __m256i vhi0 = _mm256_set_epi64x((e1 + 3) << P::YZBITS, (e1 + 2) << P::YZBITS, (e1 + 1) << P::YZBITS, (e1 + 0) << P::YZBITS);
-                        __m256i vhi1 = _mm256_set_epi64x((e1 + 7) << P::YZBITS, (e1 + 6) << P::YZBITS, (e1 + 5) << P::YZBITS, (e1 + 4) << P::YZBITS);
                         static const __m256i vhiinc = {8 << P::YZBITS, 8 << P::YZBITS, 8 << P::YZBITS, 8 << P::YZBITS};
+#elif NSIPHASH == 16
+                        const __m512i vxmask = _mm512_set1_epi64(P::XMASK);
+                        const __m512i vyzmask = _mm512_set1_epi64(P::YZMASK);
+                        const __m512i vinit0 = _mm512_set1_epi64(sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                        const __m512i vinit1 = _mm512_set1_epi64(sip_keys.k1 ^ 0x646f72616e646f6dULL);
+                        const __m512i vinit2 = _mm512_set1_epi64(sip_keys.k0 ^ 0x6c7967656e657261ULL);
+                        const __m512i vinit3 = _mm512_set1_epi64(sip_keys.k1 ^ 0x7465646279746573ULL);
+                        const __m512i vff = _mm512_set1_epi64(0xff);
+                        __m512i v0, v1, v2, v3, v4, v5, v6, v7;
+                        __m512i vpacket0, vpacket1, vhi0, vhi1;
+                        const __m512i vpacketinc = _mm512_set1_epi64(32);
+                        const __m512i vhiinc = _mm512_set1_epi64(16ULL << P::YZBITS);
+                        alignas(64) std::uint32_t uxs[NSIPHASH];
+                        alignas(64) std::uint64_t zzs[NSIPHASH];
+#elif NSIPHASH == 4
+                        const __m128i vxmask = _mm_set1_epi64x(P::XMASK);
+                        const __m128i vyzmask = _mm_set1_epi64x(P::YZMASK);
+                        const __m128i vinit0 = _mm_set1_epi64x(sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                        const __m128i vinit1 = _mm_set1_epi64x(sip_keys.k1 ^ 0x646f72616e646f6dULL);
+                        const __m128i vinit2 = _mm_set1_epi64x(sip_keys.k0 ^ 0x6c7967656e657261ULL);
+                        const __m128i vinit3 = _mm_set1_epi64x(sip_keys.k1 ^ 0x7465646279746573ULL);
+                        const __m128i vff = _mm_set1_epi64x(0xff);
+                        __m128i v0, v1, v2, v3, v4, v5, v6, v7;
+                        __m128i vpacket0, vpacket1, vhi0, vhi1;
+                        const __m128i vpacketinc = _mm_set1_epi64x(8);
+                        const __m128i vhiinc = _mm_set1_epi64x(4ULL << P::YZBITS);
+                        alignas(16) std::uint64_t uxs[NSIPHASH];
+                        alignas(16) std::uint64_t zzs[NSIPHASH];
 #endif
 
                         offset_t sumsize = 0;
-                        for (std::uint32_t my = starty; my < endy; my++, endedge += P::NYZ) {
+                        for (std::uint32_t my; (my = nextrow(uorv)) < P::NX; ) {
+                            std::uint32_t edge = my << P::YZBITS;
+                            const std::uint32_t endedge = edge + P::NYZ;
+#if NSIPHASH == 8
+                            const std::uint32_t e2 = 2 * edge + uorv;
+                            vpacket0 = _mm256_set_epi64x(e2 + 6, e2 + 4, e2 + 2, e2 + 0);
+                            vpacket1 = _mm256_set_epi64x(e2 + 14, e2 + 12, e2 + 10, e2 + 8);
+                            const std::uint64_t e1 = edge;
+                            vhi0 = _mm256_set_epi64x((e1 + 3) << P::YZBITS, (e1 + 2) << P::YZBITS, (e1 + 1) << P::YZBITS, (e1 + 0) << P::YZBITS);
+                            vhi1 = _mm256_set_epi64x((e1 + 7) << P::YZBITS, (e1 + 6) << P::YZBITS, (e1 + 5) << P::YZBITS, (e1 + 4) << P::YZBITS);
+#elif NSIPHASH == 16
+                            const std::uint32_t e2 = 2 * edge + uorv;
+                            vpacket0 = _mm512_set_epi64(e2 + 14, e2 + 12, e2 + 10, e2 + 8, e2 + 6, e2 + 4, e2 + 2, e2 + 0);
+                            vpacket1 = _mm512_set_epi64(e2 + 30, e2 + 28, e2 + 26, e2 + 24, e2 + 22, e2 + 20, e2 + 18, e2 + 16);
+                            const std::uint64_t e1 = edge;
+                            vhi0 = _mm512_set_epi64(
+                                    (e1 + 7) << P::YZBITS, (e1 + 6) << P::YZBITS, (e1 + 5) << P::YZBITS, (e1 + 4) << P::YZBITS,
+                                    (e1 + 3) << P::YZBITS, (e1 + 2) << P::YZBITS, (e1 + 1) << P::YZBITS, (e1 + 0) << P::YZBITS);
+                            vhi1 = _mm512_set_epi64(
+                                    (e1 + 15) << P::YZBITS, (e1 + 14) << P::YZBITS, (e1 + 13) << P::YZBITS, (e1 + 12) << P::YZBITS,
+                                    (e1 + 11) << P::YZBITS, (e1 + 10) << P::YZBITS, (e1 + 9) << P::YZBITS, (e1 + 8) << P::YZBITS);
+#elif NSIPHASH == 4
+                            const std::uint32_t e2 = 2 * edge + uorv;
+                            vpacket0 = _mm_set_epi64x(e2 + 2, e2 + 0);
+                            vpacket1 = _mm_set_epi64x(e2 + 6, e2 + 4);
+                            const std::uint64_t e1 = edge;
+                            vhi0 = _mm_set_epi64x((e1 + 1) << P::YZBITS, (e1 + 0) << P::YZBITS);
+                            vhi1 = _mm_set_epi64x((e1 + 3) << P::YZBITS, (e1 + 2) << P::YZBITS);
+#endif
                             dst.matrixv(my);
+                            if (wc)
+                                wc->begin(dst.index);
 
                             if (P::NEEDSYNC) {
                                 for (std::uint32_t x = 0; x < P::NX; x++) {
@@ -483,15 +1115,17 @@ namespace bitcash
                                 if (!P::NEEDSYNC) {
                                     // bit        39..21     20..13    12..0
                                     // write        edge     YYYYYY    ZZZZZ
-                                    *(BIGTYPE0*)(base + dst.index[ux]) = zz;
-                                    dst.index[ux] += P::BIGSIZE0;
+                                    emit<BIGTYPE0>(base, dst, wc, ux, zz, P::BIGSIZE0);
+                                    if (mq)
+                                        mark(*mq, ux, node & P::YZMASK);
                                 } else {
                                     if (zz) {
-                                        for (; unlikely(last[ux] + P::NNONYZ <= edge); last[ux] += P::NNONYZ, dst.index[ux] += P::BIGSIZE0)
-                                            *(std::uint32_t*)(base + dst.index[ux]) = 0;
-                                        *(std::uint32_t*)(base + dst.index[ux]) = zz;
-                                        dst.index[ux] += P::BIGSIZE0;
+                                        for (; unlikely(last[ux] + P::NNONYZ <= edge); last[ux] += P::NNONYZ)
+                                            emit<std::uint32_t>(base, dst, wc, ux, 0, P::BIGSIZE0);
+                                        emit<std::uint32_t>(base, dst, wc, ux, zz, P::BIGSIZE0);
                                         last[ux] = edge;
+                                        if (mq)
+                                            mark(*mq, ux, node & P::YZMASK);
                                     }
                                 }
 #elif NSIPHASH == 8
@@ -530,14 +1164,88 @@ namespace bitcash
 
                                 std::uint32_t ux;
 
-                                store<0, 0>(base, ux, dst, last, edge, v1, v0);
-                                store<2, 1>(base, ux, dst, last, edge, v1, v0);
-                                store<4, 2>(base, ux, dst, last, edge, v1, v0);
-                                store<6, 3>(base, ux, dst, last, edge, v1, v0);
-                                store<0, 4>(base, ux, dst, last, edge, v5, v4);
-                                store<2, 5>(base, ux, dst, last, edge, v5, v4);
-                                store<4, 6>(base, ux, dst, last, edge, v5, v4);
-                                store<6, 7>(base, ux, dst, last, edge, v5, v4);
+                                store<0, 0>(base, ux, dst, wc, mq, last, edge, v1, v0);
+                                store<2, 1>(base, ux, dst, wc, mq, last, edge, v1, v0);
+                                store<4, 2>(base, ux, dst, wc, mq, last, edge, v1, v0);
+                                store<6, 3>(base, ux, dst, wc, mq, last, edge, v1, v0);
+                                store<0, 4>(base, ux, dst, wc, mq, last, edge, v5, v4);
+                                store<2, 5>(base, ux, dst, wc, mq, last, edge, v5, v4);
+                                store<4, 6>(base, ux, dst, wc, mq, last, edge, v5, v4);
+                                store<6, 7>(base, ux, dst, wc, mq, last, edge, v5, v4);
+#elif NSIPHASH == 16
+                                v0 = v4 = vinit0;
+                                v1 = v5 = vinit1;
+                                v2 = v6 = vinit2;
+                                v3 = v7 = vinit3;
+
+                                v3 = XORX16(v3, vpacket0);
+                                v7 = XORX16(v7, vpacket1);
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                v0 = XORX16(v0, vpacket0);
+                                v4 = XORX16(v4, vpacket1);
+                                v2 = XORX16(v2, vff);
+                                v6 = XORX16(v6, vff);
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                v0 = XORX16(XORX16(v0, v1), XORX16(v2, v3));
+                                v4 = XORX16(XORX16(v4, v5), XORX16(v6, v7));
+
+                                vpacket0 = ADDX16(vpacket0, vpacketinc);
+                                vpacket1 = ADDX16(vpacket1, vpacketinc);
+                                v1 = _mm512_and_si512(_mm512_srli_epi64(v0, P::YZBITS), vxmask);
+                                v5 = _mm512_and_si512(_mm512_srli_epi64(v4, P::YZBITS), vxmask);
+                                v0 = _mm512_or_si512(_mm512_and_si512(v0, vyzmask), vhi0);
+                                v4 = _mm512_or_si512(_mm512_and_si512(v4, vyzmask), vhi1);
+                                vhi0 = ADDX16(vhi0, vhiinc);
+                                vhi1 = ADDX16(vhi1, vhiinc);
+
+                                _mm256_store_si256((__m256i*)uxs, _mm512_cvtepi64_epi32(v1));
+                                _mm256_store_si256((__m256i*)(uxs + 8), _mm512_cvtepi64_epi32(v5));
+                                _mm512_store_si512(zzs, v0);
+                                _mm512_store_si512(zzs + 8, v4);
+                                for (std::uint32_t i = 0; i < NSIPHASH; i++) {
+                                    store(base, dst, wc, mq, last, edge + i, uxs[i], zzs[i]);
+                                }
+#elif NSIPHASH == 4
+                                v0 = v4 = vinit0;
+                                v1 = v5 = vinit1;
+                                v2 = v6 = vinit2;
+                                v3 = v7 = vinit3;
+
+                                v3 = XORX4(v3, vpacket0);
+                                v7 = XORX4(v7, vpacket1);
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                v0 = XORX4(v0, vpacket0);
+                                v4 = XORX4(v4, vpacket1);
+                                v2 = XORX4(v2, vff);
+                                v6 = XORX4(v6, vff);
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                v0 = XORX4(XORX4(v0, v1), XORX4(v2, v3));
+                                v4 = XORX4(XORX4(v4, v5), XORX4(v6, v7));
+
+                                vpacket0 = ADDX4(vpacket0, vpacketinc);
+                                vpacket1 = ADDX4(vpacket1, vpacketinc);
+                                v1 = _mm_and_si128(_mm_srli_epi64(v0, P::YZBITS), vxmask);
+                                v5 = _mm_and_si128(_mm_srli_epi64(v4, P::YZBITS), vxmask);
+                                v0 = _mm_or_si128(_mm_and_si128(v0, vyzmask), vhi0);
+                                v4 = _mm_or_si128(_mm_and_si128(v4, vyzmask), vhi1);
+                                vhi0 = ADDX4(vhi0, vhiinc);
+                                vhi1 = ADDX4(vhi1, vhiinc);
+
+                                _mm_store_si128((__m128i*)uxs, v1);
+                                _mm_store_si128((__m128i*)(uxs + 2), v5);
+                                _mm_store_si128((__m128i*)zzs, v0);
+                                _mm_store_si128((__m128i*)(zzs + 2), v4);
+                                for (std::uint32_t i = 0; i < NSIPHASH; i++) {
+                                    store(base, dst, wc, mq, last, edge + i, uxs[i], zzs[i]);
+                                }
 #else
 #error not implemented
 #endif
@@ -545,184 +1253,323 @@ namespace bitcash
 
                             if (P::NEEDSYNC) {
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
-                                    for (; last[ux] < endedge - P::NNONYZ; last[ux] += P::NNONYZ) {
-                                        *(std::uint32_t*)(base + dst.index[ux]) = 0;
-                                        dst.index[ux] += P::BIGSIZE0;
-                                    }
+                                    for (; last[ux] < endedge - P::NNONYZ; last[ux] += P::NNONYZ)
+                                        emit<std::uint32_t>(base, dst, wc, ux, 0, P::BIGSIZE0);
                                 }
                             }
 
+                            if (wc)
+                                wc->end(base, dst.index);
                             sumsize += dst.storev(buckets, my);
                         }
+                        if (mq)
+                            marks(*mq);
+                        spill(dst);
                         tcounts[id] = sumsize / P::BIGSIZE0;
                     }
 
                     // Porcess butckets and discard nodes with one edge for it (means it won't be in a cycle)
                     // Generate new paired nodes for remaining nodes generated in genUnodes step
-                    void genVnodes(const std::uint32_t id, const std::uint32_t uorv)
-                    {
+                    template <bool INDEXED>
+                        void genVnodes(const std::uint32_t id, const std::uint32_t uorv)
+                        {
 #if NSIPHASH == 8
-                        static const __m256i vxmask = {P::XMASK, P::XMASK, P::XMASK, P::XMASK};
-                        static const __m256i vyzmask = {P::YZMASK, P::YZMASK, P::YZMASK, P::YZMASK};
-                        const __m256i vinit = _mm256_set_epi64x(
-                                sip_keys.k1 ^ 0x7465646279746573ULL,
-                                sip_keys.k0 ^ 0x6c7967656e657261ULL,
-                                sip_keys.k1 ^ 0x646f72616e646f6dULL,
-                                sip_keys.k0 ^ 0x736f6d6570736575ULL);
-                        __m256i vpacket0, vpacket1, vhi0, vhi1;
-                        __m256i v0, v1, v2, v3, v4, v5, v6, v7;
+                            static const __m256i vxmask = {P::XMASK, P::XMASK, P::XMASK, P::XMASK};
+                            static const __m256i vyzmask = {P::YZMASK, P::YZMASK, P::YZMASK, P::YZMASK};
+                            const __m256i vinit = _mm256_set_epi64x(
+                                    sip_keys.k1 ^ 0x7465646279746573ULL,
+                                    sip_keys.k0 ^ 0x6c7967656e657261ULL,
+                                    sip_keys.k1 ^ 0x646f72616e646f6dULL,
+                                    sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                            __m256i vpacket0, vpacket1, vhi0, vhi1;
+                            __m256i v0, v1, v2, v3, v4, v5, v6, v7;
+#elif NSIPHASH == 16
+                            const __m512i vxmask = _mm512_set1_epi64(P::XMASK);
+                            const __m512i vyzmask = _mm512_set1_epi64(P::YZMASK);
+                            const __m512i vinit0 = _mm512_set1_epi64(sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                            const __m512i vinit1 = _mm512_set1_epi64(sip_keys.k1 ^ 0x646f72616e646f6dULL);
+                            const __m512i vinit2 = _mm512_set1_epi64(sip_keys.k0 ^ 0x6c7967656e657261ULL);
+                            const __m512i vinit3 = _mm512_set1_epi64(sip_keys.k1 ^ 0x7465646279746573ULL);
+                            const __m512i vff = _mm512_set1_epi64(0xff);
+                            __m512i vpacket0, vpacket1, vhi0, vhi1;
+                            __m512i v0, v1, v2, v3, v4, v5, v6, v7;
+                            alignas(64) std::uint32_t vxs[NSIPHASH];
+                            alignas(64) std::uint64_t ws[NSIPHASH];
+#elif NSIPHASH == 4
+                            const __m128i vxmask = _mm_set1_epi64x(P::XMASK);
+                            const __m128i vyzmask = _mm_set1_epi64x(P::YZMASK);
+                            const __m128i vinit0 = _mm_set1_epi64x(sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                            const __m128i vinit1 = _mm_set1_epi64x(sip_keys.k1 ^ 0x646f72616e646f6dULL);
+                            const __m128i vinit2 = _mm_set1_epi64x(sip_keys.k0 ^ 0x6c7967656e657261ULL);
+                            const __m128i vinit3 = _mm_set1_epi64x(sip_keys.k1 ^ 0x7465646279746573ULL);
+                            const __m128i vff = _mm_set1_epi64x(0xff);
+                            __m128i vpacket0, vpacket1, vhi0, vhi1;
+                            __m128i v0, v1, v2, v3, v4, v5, v6, v7;
+                            alignas(16) std::uint64_t vxs[NSIPHASH];
+                            alignas(16) std::uint64_t ws[NSIPHASH];
 #endif
 
-                        static const std::uint32_t NONDEGBITS = std::min(40u, 2 * P::YZBITS) - P::ZBITS; // 28
-                        static const std::uint32_t NONDEGMASK = (1 << NONDEGBITS) - 1;
-                        indexerZ dst;
-                        indexerT small;
+                            static const std::uint32_t NONDEGBITS = std::min(40u, 2 * P::YZBITS) - P::ZBITS; // 28
+                            static const std::uint32_t NONDEGMASK = (1 << NONDEGBITS) - 1;
+                            indexerZ dst;
+                            indexerT small;
+                            indexerL ldst;
+                            wcbufferZ* wc = stage(id, (std::uint64_t)live * P::BIGSIZE);
 
-                        offset_t sumsize = 0;
-                        std::uint8_t const* base = (std::uint8_t*)buckets;
-                        std::uint8_t const* small0 = (std::uint8_t*)tbuckets[id];
-                        const std::uint32_t startux = P::NX * id / threads;
-                        const std::uint32_t endux = P::NX * (id + 1) / threads;
-
-                        for (std::uint32_t ux = startux; ux < endux; ux++) { // matrix x == ux
-                            small.matrixu(0);
-                            for (std::uint32_t my = 0; my < P::NY; my++) {
-                                std::uint32_t edge = my << P::YZBITS;
-                                std::uint8_t* readbig = buckets[ux][my].bytes;
-                                std::uint8_t const* endreadbig = readbig + buckets[ux][my].size;
-                                for (; readbig < endreadbig; readbig += P::BIGSIZE0) {
-                                    // bit     39/31..21     20..13    12..0
-                                    // read         edge     UYYYYY    UZZZZ   within UX partition
-                                    BIGTYPE0 e = *(BIGTYPE0*)readbig;
-                                    if (P::BIGSIZE0 > 4) {
-                                        e &= P::BIGSLOTMASK0;
-                                    } else if (P::NEEDSYNC) {
-                                        if (unlikely(!e)) {
-                                            edge += P::NNONYZ;
-                                            continue;
+                            offset_t sumsize = 0;
+                            std::uint8_t const* base = (std::uint8_t*)buckets;
+                            std::uint8_t const* small0 = (std::uint8_t*)tbuckets[id];
+                            std::uint8_t const* lbase = (std::uint8_t*)lanes;
+
+                            for (std::uint32_t ux; (ux = nextrow(uorv)) < P::NX; ) { // matrix x == ux
+                                small.matrixu(0);
+                                for (std::uint32_t my = 0; my < P::NX; my++) {
+                                    std::uint32_t edge = my << P::YZBITS;
+                                    std::uint8_t* readbig = buckets[ux][my].bytes;
+                                    std::uint8_t const* endreadbig = readbig + buckets[ux][my].fill();
+                                    for (; readbig < endreadbig; readbig += P::BIGSIZE0) {
+                                        // bit     39/31..21     20..13    12..0
+                                        // read         edge     UYYYYY    UZZZZ   within UX partition
+                                        BIGTYPE0 e = *(BIGTYPE0*)readbig;
+                                        if (P::BIGSIZE0 > 4) {
+                                            e &= P::BIGSLOTMASK0;
+                                        } else if (P::NEEDSYNC) {
+                                            if (unlikely(!e)) {
+                                                edge += P::NNONYZ;
+                                                continue;
+                                            }
                                         }
+                                        // restore edge generated in genUnodes
+                                        edge += ((std::uint32_t)(e >> P::YZBITS) - edge) & (P::NNONYZ - 1);
+                                        // edges of a U node seen only once go no further
+                                        if (nodebits && !twice(ux, e & P::YZMASK))
+                                            continue;
+                                        const std::uint32_t uy = (e >> P::ZBITS) & P::YMASK;
+                                        // bit         39..13     12..0
+                                        // write         edge     UZZZZ   within UX UY partition
+                                        *(std::uint64_t*)(small0 + small.index[uy]) = ((std::uint64_t)edge << P::ZBITS) | (e & P::ZMASK);
+                                        small.index[uy] += P::SMALLSIZE;
                                     }
-                                    // restore edge generated in genUnodes
-                                    edge += ((std::uint32_t)(e >> P::YZBITS) - edge) & (P::NNONYZ - 1);
-                                    const std::uint32_t uy = (e >> P::ZBITS) & P::YMASK;
-                                    // bit         39..13     12..0
-                                    // write         edge     UZZZZ   within UX UY partition
-                                    *(std::uint64_t*)(small0 + small.index[uy]) = ((std::uint64_t)edge << P::ZBITS) | (e & P::ZMASK);
-                                    small.index[uy] += P::SMALLSIZE;
                                 }
-                            }
 
-                            // counts of zz's for this ux
-                            std::uint8_t* degs = tdegs[id];
-                            small.storeu(tbuckets + id, 0);
-                            dst.matrixu(ux);
-                            for (std::uint32_t uy = 0; uy < P::NY; uy++) {
-                                memset(degs, 0xff, P::NZ);
-                                std::uint8_t *readsmall = tbuckets[id][uy].bytes, *endreadsmall = readsmall + tbuckets[id][uy].size;
-
-                                for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += P::SMALLSIZE) {
-                                    degs[*(std::uint32_t*)rdsmall & P::ZMASK]++;
-                                }
+                                // counts of zz's for this ux
+                                std::uint8_t* degs = tdegs[id];
+                                small.storeu(tbuckets + id, 0);
+                                if (spill(small))
+                                    continue;
+                                dst.matrixu(ux);
+                                if (wc)
+                                    wc->begin(dst.index);
+                                if (INDEXED)
+                                    ldst.matrixu(ux);
+                                if (nodebits)
+                                    unmark(ux);
+                                for (std::uint32_t uy = 0; uy < P::NY; uy++) {
+                                    std::uint8_t *readsmall = tbuckets[id][uy].bytes, *endreadsmall = readsmall + tbuckets[id][uy].size;
+
+                                    // with the node marks only edges of nodes with two or
+                                    // more are left, no need to count them again
+                                    if (!nodebits) {
+                                        memset(degs, 0xff, P::NZ);
+                                        for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += P::SMALLSIZE) {
+                                            degs[*(std::uint32_t*)rdsmall & P::ZMASK]++;
+                                        }
+                                    }
 
-                                std::uint16_t* zs = tzs[id];
-                                std::uint32_t* edges0;
-                                edges0 = tedges[id]; // list of nodes with 2+ edges
-                                std::uint32_t *edges = edges0, edge = 0;
-
-                                for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += P::SMALLSIZE) {
-                                    // bit         39..13     12..0
-                                    // read          edge     UZZZZ    sorted by UY within UX partition
-                                    const std::uint64_t e = *(std::uint64_t*)rdsmall;
-
-                                    edge += ((e >> P::ZBITS) - edge) & NONDEGMASK;
-                                    *edges = edge;
-                                    const std::uint32_t z = e & P::ZMASK;
-                                    *zs = z;
-
-                                    // check if array of ZZs counts (degs[]) has value not equal to 0 (means we have one edge for that node)
-                                    // if it's the only edge, then it would be rewritten in zs and edges arrays in next iteration (skipped)
-                                    const std::uint32_t delta = degs[z] ? 1 : 0;
-                                    edges += delta;
-                                    zs += delta;
-                                }
-                                assert(edges - edges0 < P::NTRIMMEDZ);
-                                const std::uint16_t* readz = tzs[id];
-                                const std::uint32_t* readedge = edges0;
-                                std::int64_t uy34 = (std::int64_t)uy << P::YZZBITS;
+                                    std::uint16_t* zs = tzs[id];
+                                    std::uint32_t* edges0;
+                                    edges0 = tedges[id]; // list of nodes with 2+ edges
+                                    std::uint32_t *edges = edges0, edge = 0;
+
+                                    for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += P::SMALLSIZE) {
+                                        // bit         39..13     12..0
+                                        // read          edge     UZZZZ    sorted by UY within UX partition
+                                        const std::uint64_t e = *(std::uint64_t*)rdsmall;
+
+                                        edge += ((e >> P::ZBITS) - edge) & NONDEGMASK;
+                                        *edges = edge;
+                                        const std::uint32_t z = e & P::ZMASK;
+                                        *zs = z;
+
+                                        // check if array of ZZs counts (degs[]) has value not equal to 0 (means we have one edge for that node)
+                                        // if it's the only edge, then it would be rewritten in zs and edges arrays in next iteration (skipped)
+                                        const std::uint32_t delta = nodebits || degs[z] ? 1 : 0;
+                                        edges += delta;
+                                        zs += delta;
+                                    }
+                                    assert(edges - edges0 < P::NTRIMMEDZ);
+                                    const std::uint16_t* readz = tzs[id];
+                                    const std::uint32_t* readedge = edges0;
+                                    std::int64_t uy34 = (std::int64_t)uy << P::YZZBITS;
 
 #if NSIPHASH == 8
-                                const __m256i vuy34 = {uy34, uy34, uy34, uy34};
-                                const __m256i vuorv = {uorv, uorv, uorv, uorv};
-                                for (; readedge <= edges - NSIPHASH; readedge += NSIPHASH, readz += NSIPHASH) {
-                                    v3 = _mm256_permute4x64_epi64(vinit, 0xFF);
-                                    v0 = _mm256_permute4x64_epi64(vinit, 0x00);
-                                    v1 = _mm256_permute4x64_epi64(vinit, 0x55);
-                                    v2 = _mm256_permute4x64_epi64(vinit, 0xAA);
-                                    v7 = _mm256_permute4x64_epi64(vinit, 0xFF);
-                                    v4 = _mm256_permute4x64_epi64(vinit, 0x00);
-                                    v5 = _mm256_permute4x64_epi64(vinit, 0x55);
-                                    v6 = _mm256_permute4x64_epi64(vinit, 0xAA);
-
-                                    vpacket0 = _mm256_slli_epi64(_mm256_cvtepu32_epi64(*(__m128i*)readedge), 1) | vuorv;
-                                    vhi0 = vuy34 | _mm256_slli_epi64(_mm256_cvtepu16_epi64(_mm_set_epi64x(0, *(std::uint64_t*)readz)), P::YZBITS);
-                                    vpacket1 = _mm256_slli_epi64(_mm256_cvtepu32_epi64(*(__m128i*)(readedge + 4)), 1) | vuorv;
-                                    vhi1 = vuy34 | _mm256_slli_epi64(_mm256_cvtepu16_epi64(_mm_set_epi64x(0, *(std::uint64_t*)(readz + 4))), P::YZBITS);
-
-                                    v3 = XOR(v3, vpacket0);
-                                    v7 = XOR(v7, vpacket1);
-                                    SIPROUNDX8;
-                                    SIPROUNDX8;
-                                    v0 = XOR(v0, vpacket0);
-                                    v4 = XOR(v4, vpacket1);
-                                    v2 = XOR(v2, _mm256_broadcastq_epi64(_mm_cvtsi64_si128(0xff)));
-                                    v6 = XOR(v6, _mm256_broadcastq_epi64(_mm_cvtsi64_si128(0xff)));
-                                    SIPROUNDX8;
-                                    SIPROUNDX8;
-                                    SIPROUNDX8;
-                                    SIPROUNDX8;
-                                    v0 = XOR(XOR(v0, v1), XOR(v2, v3));
-                                    v4 = XOR(XOR(v4, v5), XOR(v6, v7));
-
-                                    v1 = _mm256_srli_epi64(v0, P::YZBITS) & vxmask;
-                                    v5 = _mm256_srli_epi64(v4, P::YZBITS) & vxmask;
-                                    v0 = vhi0 | (v0 & vyzmask);
-                                    v4 = vhi1 | (v4 & vyzmask);
-
-                                    std::uint32_t vx;
+                                    const __m256i vuy34 = {uy34, uy34, uy34, uy34};
+                                    const __m256i vuorv = {uorv, uorv, uorv, uorv};
+                                    for (; readedge <= edges - NSIPHASH; readedge += NSIPHASH, readz += NSIPHASH) {
+                                        v3 = _mm256_permute4x64_epi64(vinit, 0xFF);
+                                        v0 = _mm256_permute4x64_epi64(vinit, 0x00);
+                                        v1 = _mm256_permute4x64_epi64(vinit, 0x55);
+                                        v2 = _mm256_permute4x64_epi64(vinit, 0xAA);
+                                        v7 = _mm256_permute4x64_epi64(vinit, 0xFF);
+                                        v4 = _mm256_permute4x64_epi64(vinit, 0x00);
+                                        v5 = _mm256_permute4x64_epi64(vinit, 0x55);
+                                        v6 = _mm256_permute4x64_epi64(vinit, 0xAA);
+
+                                        vpacket0 = _mm256_slli_epi64(_mm256_cvtepu32_epi64(*(__m128i*)readedge), 1) | vuorv;
+                                        vhi0 = vuy34 | _mm256_slli_epi64(_mm256_cvtepu16_epi64(_mm_set_epi64x(0, *(std::uint64_t*)readz)), P::YZBITS);
+                                        vpacket1 = _mm256_slli_epi64(_mm256_cvtepu32_epi64(*(__m128i*)(readedge + 4)), 1) | vuorv;
+                                        vhi1 = vuy34 | _mm256_slli_epi64(_mm256_cvtepu16_epi64(_mm_set_epi64x(0, *(std::uint64_t*)(readz + 4))), P::YZBITS);
+
+                                        v3 = XOR(v3, vpacket0);
+                                        v7 = XOR(v7, vpacket1);
+                                        SIPROUNDX8;
+                                        SIPROUNDX8;
+                                        v0 = XOR(v0, vpacket0);
+                                        v4 = XOR(v4, vpacket1);
+                                        v2 = XOR(v2, _mm256_broadcastq_epi64(_mm_cvtsi64_si128(0xff)));
+                                        v6 = XOR(v6, _mm256_broadcastq_epi64(_mm_cvtsi64_si128(0xff)));
+                                        SIPROUNDX8;
+                                        SIPROUNDX8;
+                                        SIPROUNDX8;
+                                        SIPROUNDX8;
+                                        v0 = XOR(XOR(v0, v1), XOR(v2, v3));
+                                        v4 = XOR(XOR(v4, v5), XOR(v6, v7));
+
+                                        v1 = _mm256_srli_epi64(v0, P::YZBITS) & vxmask;
+                                        v5 = _mm256_srli_epi64(v4, P::YZBITS) & vxmask;
+                                        v0 = vhi0 | (v0 & vyzmask);
+                                        v4 = vhi1 | (v4 & vyzmask);
+
+                                        std::uint32_t vx;
 #define STORE(i, v, x, w)                                                \
-                                    vx = _mm256_extract_epi32(v, x);                                     \
-                                    *(std::uint64_t*)(base + dst.index[vx]) = _mm256_extract_epi64(w, i % 4); \
-                                    dst.index[vx] += P::BIGSIZE;
-                                    STORE(0, v1, 0, v0);
-                                    STORE(1, v1, 2, v0);
-                                    STORE(2, v1, 4, v0);
-                                    STORE(3, v1, 6, v0);
-                                    STORE(4, v5, 0, v4);
-                                    STORE(5, v5, 2, v4);
-                                    STORE(6, v5, 4, v4);
-                                    STORE(7, v5, 6, v4);
-                                }
+                                        vx = _mm256_extract_epi32(v, x);                                     \
+                                        emit<std::uint64_t>(base, dst, wc, vx, _mm256_extract_epi64(w, i % 4), P::BIGSIZE); \
+                                        if (INDEXED)                                                         \
+                                            lanestore(lbase, ldst, vx, readedge[i]);
+                                        STORE(0, v1, 0, v0);
+                                        STORE(1, v1, 2, v0);
+                                        STORE(2, v1, 4, v0);
+                                        STORE(3, v1, 6, v0);
+                                        STORE(4, v5, 0, v4);
+                                        STORE(5, v5, 2, v4);
+                                        STORE(6, v5, 4, v4);
+                                        STORE(7, v5, 6, v4);
+                                    }
+#elif NSIPHASH == 16
+                                    const __m512i vuy34 = _mm512_set1_epi64(uy34);
+                                    const __m512i vuorv = _mm512_set1_epi64(uorv);
+                                    for (; readedge <= edges - NSIPHASH; readedge += NSIPHASH, readz += NSIPHASH) {
+                                        v0 = v4 = vinit0;
+                                        v1 = v5 = vinit1;
+                                        v2 = v6 = vinit2;
+                                        v3 = v7 = vinit3;
+
+                                        vpacket0 = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm256_loadu_si256((__m256i*)readedge)), 1), vuorv);
+                                        vhi0 = _mm512_or_si512(vuy34, _mm512_slli_epi64(_mm512_cvtepu16_epi64(_mm_loadu_si128((__m128i*)readz)), P::YZBITS));
+                                        vpacket1 = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm256_loadu_si256((__m256i*)(readedge + 8))), 1), vuorv);
+                                        vhi1 = _mm512_or_si512(vuy34, _mm512_slli_epi64(_mm512_cvtepu16_epi64(_mm_loadu_si128((__m128i*)(readz + 8))), P::YZBITS));
+
+                                        v3 = XORX16(v3, vpacket0);
+                                        v7 = XORX16(v7, vpacket1);
+                                        SIPROUNDX16;
+                                        SIPROUNDX16;
+                                        v0 = XORX16(v0, vpacket0);
+                                        v4 = XORX16(v4, vpacket1);
+                                        v2 = XORX16(v2, vff);
+                                        v6 = XORX16(v6, vff);
+                                        SIPROUNDX16;
+                                        SIPROUNDX16;
+                                        SIPROUNDX16;
+                                        SIPROUNDX16;
+                                        v0 = XORX16(XORX16(v0, v1), XORX16(v2, v3));
+                                        v4 = XORX16(XORX16(v4, v5), XORX16(v6, v7));
+
+                                        v1 = _mm512_and_si512(_mm512_srli_epi64(v0, P::YZBITS), vxmask);
+                                        v5 = _mm512_and_si512(_mm512_srli_epi64(v4, P::YZBITS), vxmask);
+                                        v0 = _mm512_or_si512(vhi0, _mm512_and_si512(v0, vyzmask));
+                                        v4 = _mm512_or_si512(vhi1, _mm512_and_si512(v4, vyzmask));
+
+                                        _mm256_store_si256((__m256i*)vxs, _mm512_cvtepi64_epi32(v1));
+                                        _mm256_store_si256((__m256i*)(vxs + 8), _mm512_cvtepi64_epi32(v5));
+                                        _mm512_store_si512(ws, v0);
+                                        _mm512_store_si512(ws + 8, v4);
+                                        for (std::uint32_t i = 0; i < NSIPHASH; i++) {
+                                            emit<std::uint64_t>(base, dst, wc, vxs[i], ws[i], P::BIGSIZE);
+                                            if (INDEXED)
+                                                lanestore(lbase, ldst, vxs[i], readedge[i]);
+                                        }
+                                    }
+#elif NSIPHASH == 4
+                                    const __m128i vuy34 = _mm_set1_epi64x(uy34);
+                                    const __m128i vuorv = _mm_set1_epi64x(uorv);
+                                    for (; readedge <= edges - NSIPHASH; readedge += NSIPHASH, readz += NSIPHASH) {
+                                        v0 = v4 = vinit0;
+                                        v1 = v5 = vinit1;
+                                        v2 = v6 = vinit2;
+                                        v3 = v7 = vinit3;
+
+                                        vpacket0 = _mm_or_si128(_mm_slli_epi64(_mm_cvtepu32_epi64(_mm_loadl_epi64((__m128i*)readedge)), 1), vuorv);
+                                        vhi0 = _mm_or_si128(vuy34, _mm_slli_epi64(_mm_cvtepu16_epi64(_mm_cvtsi32_si128(*(std::uint32_t*)readz)), P::YZBITS));
+                                        vpacket1 = _mm_or_si128(_mm_slli_epi64(_mm_cvtepu32_epi64(_mm_loadl_epi64((__m128i*)(readedge + 2))), 1), vuorv);
+                                        vhi1 = _mm_or_si128(vuy34, _mm_slli_epi64(_mm_cvtepu16_epi64(_mm_cvtsi32_si128(*(std::uint32_t*)(readz + 2))), P::YZBITS));
+
+                                        v3 = XORX4(v3, vpacket0);
+                                        v7 = XORX4(v7, vpacket1);
+                                        SIPROUNDX4;
+                                        SIPROUNDX4;
+                                        v0 = XORX4(v0, vpacket0);
+                                        v4 = XORX4(v4, vpacket1);
+                                        v2 = XORX4(v2, vff);
+                                        v6 = XORX4(v6, vff);
+                                        SIPROUNDX4;
+                                        SIPROUNDX4;
+                                        SIPROUNDX4;
+                                        SIPROUNDX4;
+                                        v0 = XORX4(XORX4(v0, v1), XORX4(v2, v3));
+                                        v4 = XORX4(XORX4(v4, v5), XORX4(v6, v7));
+
+                                        v1 = _mm_and_si128(_mm_srli_epi64(v0, P::YZBITS), vxmask);
+                                        v5 = _mm_and_si128(_mm_srli_epi64(v4, P::YZBITS), vxmask);
+                                        v0 = _mm_or_si128(vhi0, _mm_and_si128(v0, vyzmask));
+                                        v4 = _mm_or_si128(vhi1, _mm_and_si128(v4, vyzmask));
+
+                                        _mm_store_si128((__m128i*)vxs, v1);
+                                        _mm_store_si128((__m128i*)(vxs + 2), v5);
+                                        _mm_store_si128((__m128i*)ws, v0);
+                                        _mm_store_si128((__m128i*)(ws + 2), v4);
+                                        for (std::uint32_t i = 0; i < NSIPHASH; i++) {
+                                            emit<std::uint64_t>(base, dst, wc, vxs[i], ws[i], P::BIGSIZE);
+                                            if (INDEXED)
+                                                lanestore(lbase, ldst, vxs[i], readedge[i]);
+                                        }
+                                    }
 #endif
 
-                                for (; readedge < edges; readedge++, readz++) { // process up to 7 leftover edges if NSIPHASH==8
-                                    const std::uint32_t node = _sipnode(&sip_keys, P::EDGEMASK, *readedge, uorv);
-                                    const std::uint32_t vx = node >> P::YZBITS; // & XMASK;
-
-                                    // bit        39..34    33..21     20..13     12..0
-                                    // write      UYYYYY    UZZZZZ     VYYYYY     VZZZZ   within VX partition
-                                    // prev bucket info generated in genUnodes is overwritten here,
-                                    // as we store U and V nodes in one value (Yz and Zs; Xs are indices in a matrix)
-                                    // edge is discarded here, as we do not need it anymore
-                                    *(std::uint64_t*)(base + dst.index[vx]) = uy34 | ((std::uint64_t)*readz << P::YZBITS) | (node & P::YZMASK);
-                                    dst.index[vx] += P::BIGSIZE;
+                                    for (; readedge < edges; readedge++, readz++) { // process up to NSIPHASH-1 leftover edges
+                                        const std::uint32_t node = _sipnode(&sip_keys, P::EDGEMASK, *readedge, uorv);
+                                        const std::uint32_t vx = node >> P::YZBITS; // & XMASK;
+
+                                        // bit        39..34    33..21     20..13     12..0
+                                        // write      UYYYYY    UZZZZZ     VYYYYY     VZZZZ   within VX partition
+                                        // prev bucket info generated in genUnodes is overwritten here,
+                                        // as we store U and V nodes in one value (Yz and Zs; Xs are indices in a matrix)
+                                        // edge is discarded here, as we do not need it anymore
+                                        emit<std::uint64_t>(base, dst, wc, vx, uy34 | ((std::uint64_t)*readz << P::YZBITS) | (node & P::YZMASK), P::BIGSIZE);
+                                        if (INDEXED)
+                                            lanestore(lbase, ldst, vx, *readedge);
+                                    }
                                 }
+                                if (wc)
+                                    wc->end(base, dst.index);
+                                sumsize += dst.storeu(buckets, ux);
                             }
-                            sumsize += dst.storeu(buckets, ux);
+                            spill(dst);
+                            if (INDEXED)
+                                spill(ldst);
+                            tcounts[id] = sumsize / P::BIGSIZE;
                         }
-                        tcounts[id] = sumsize / P::BIGSIZE;
-                    }
 
-                    template <std::uint32_t SRCSIZE, std::uint32_t DSTSIZE, bool TRIMONV>
+                    template <std::uint32_t SRCSIZE, std::uint32_t DSTSIZE, bool TRIMONV, bool INDEXED>
                         void trimedges(const std::uint32_t id, const std::uint32_t round)
                         {
                             const std::uint32_t SRCSLOTBITS = std::min(SRCSIZE * 8, 2 * P::YZBITS);
@@ -735,18 +1582,26 @@ namespace bitcash
                             const std::uint32_t DSTPREFMASK = (1 << DSTPREFBITS) - 1;
                             indexerZ dst;
                             indexerT small;
+                            indexerL ldst;
+                            indexerTL lsmall;
+                            wcbufferZ* wc = stage(id, (std::uint64_t)live * DSTSIZE);
 
                             offset_t sumsize = 0;
                             std::uint8_t const* base = (std::uint8_t*)buckets;
                             std::uint8_t const* small0 = (std::uint8_t*)tbuckets[id];
-                            const std::uint32_t startvx = P::NY * id / threads;
-                            const std::uint32_t endvx = P::NY * (id + 1) / threads;
-                            for (std::uint32_t vx = startvx; vx < endvx; vx++) {
+                            std::uint8_t const* lbase = (std::uint8_t*)lanes;
+                            std::uint8_t const* lsmall0 = (std::uint8_t*)tlanes[id];
+                            for (std::uint32_t vx; (vx = nextrow(round)) < P::NX; ) {
                                 small.matrixu(0);
+                                if (INDEXED)
+                                    lsmall.matrixu(0);
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
                                     std::uint32_t uxyz = ux << P::YZBITS;
                                     zbucketZ& zb = TRIMONV ? buckets[ux][vx] : buckets[vx][ux];
-                                    const std::uint8_t *readbig = zb.bytes, *endreadbig = readbig + zb.size;
+                                    if (prefetch_distance && ux + 1 < P::NX)
+                                        prefetch((TRIMONV ? buckets[ux + 1][vx] : buckets[vx][ux + 1]).bytes);
+                                    const std::uint8_t *readbig = zb.bytes, *endreadbig = readbig + zb.fill();
+                                    const std::uint32_t* readlane = INDEXED ? (TRIMONV ? lanes[ux][vx] : lanes[vx][ux]).words : nullptr;
                                     for (; readbig < endreadbig; readbig += SRCSIZE) {
                                         // bit        39..34    33..21     20..13     12..0
                                         // write      UYYYYY    UZZZZZ     VYYYYY     VZZZZ   within VX partition
@@ -758,22 +1613,40 @@ namespace bitcash
                                         *(std::uint64_t*)(small0 + small.index[vy]) = ((std::uint64_t)uxyz << P::ZBITS) | (e & P::ZMASK);
                                         uxyz &= ~P::ZMASK;
                                         small.index[vy] += DSTSIZE;
+                                        if (INDEXED)
+                                            lanestore(lsmall0, lsmall, vy, *readlane++);
                                     }
+                                    // only a bucket spilled into has edges of another
                                     if (unlikely(uxyz >> P::YZBITS != ux)) {
-                                        assert(false);
+                                        small.spilled = true;
                                     }
                                 }
                                 std::uint8_t* degs = tdegs[id];
                                 small.storeu(tbuckets + id, 0);
+                                if (spill(small) || (INDEXED && spill(lsmall)))
+                                    continue;
                                 TRIMONV ? dst.matrixv(vx) : dst.matrixu(vx);
+                                if (wc)
+                                    wc->begin(dst.index);
+                                if (INDEXED)
+                                    TRIMONV ? ldst.matrixv(vx) : ldst.matrixu(vx);
                                 for (std::uint32_t vy = 0; vy < P::NY; vy++) {
                                     const std::uint64_t vy34 = (std::uint64_t)vy << P::YZZBITS;
+                                    const std::uint32_t* readlane = INDEXED ? tlanes[id][vy].words : nullptr;
                                     memset(degs, 0xff, P::NZ);
                                     std::uint8_t *readsmall = tbuckets[id][vy].bytes, *endreadsmall = readsmall + tbuckets[id][vy].size;
-                                    for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += DSTSIZE)
+                                    const std::uint32_t dist = prefetch_distance * DSTSIZE;
+                                    if (dist && vy + 1 < P::NY)
+                                        prefetch(tbuckets[id][vy + 1].bytes);
+                                    for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += DSTSIZE) {
+                                        if (dist)
+                                            prefetch(degs + (*(std::uint32_t*)ahead(rdsmall, endreadsmall, dist) & P::ZMASK));
                                         degs[*(std::uint32_t*)rdsmall & P::ZMASK]++;
+                                    }
                                     std::uint32_t ux = 0;
                                     for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += DSTSIZE) {
+                                        if (dist)
+                                            prefetch(degs + (*(std::uint32_t*)ahead(rdsmall, endreadsmall, dist) & P::ZMASK));
                                         // bit     41/39..34    33..26     25..13     12..0
                                         // read       UXXXXX    UYYYYY     UZZZZZ     VZZZZ   within VX VY partition
                                         // bit        39..37    36..30     29..15     14..0      with XBITS==YBITS==7
@@ -782,16 +1655,22 @@ namespace bitcash
                                         ux += ((std::uint32_t)(e >> P::YZZBITS) - ux) & DSTPREFMASK;
                                         // bit    41/39..34    33..21     20..13     12..0
                                         // write     VYYYYY    VZZZZZ     UYYYYY     UZZZZ   within UX partition
-                                        *(std::uint64_t*)(base + dst.index[ux]) = vy34 | ((e & P::ZMASK) << P::YZBITS) | ((e >> P::ZBITS) & P::YZMASK);
-                                        dst.index[ux] += degs[e & P::ZMASK] ? DSTSIZE : 0;
+                                        emit<std::uint64_t>(base, dst, wc, ux, vy34 | ((e & P::ZMASK) << P::YZBITS) | ((e >> P::ZBITS) & P::YZMASK), degs[e & P::ZMASK] ? DSTSIZE : 0);
+                                        if (INDEXED)
+                                            lanestore(lbase, ldst, ux, *readlane++, degs[e & P::ZMASK] ? sizeof(std::uint32_t) : 0);
                                     }
                                 }
+                                if (wc)
+                                    wc->end(base, dst.index);
                                 sumsize += TRIMONV ? dst.storev(buckets, vx) : dst.storeu(buckets, vx);
                             }
+                            spill(dst);
+                            if (INDEXED)
+                                spill(ldst);
                             tcounts[id] = sumsize / DSTSIZE;
                         }
 
-                    template <std::uint32_t SRCSIZE, std::uint32_t DSTSIZE, bool TRIMONV>
+                    template <std::uint32_t SRCSIZE, std::uint32_t DSTSIZE, bool TRIMONV, bool INDEXED>
                         void trimrename(const std::uint32_t id, const std::uint32_t round)
                         {
                             const std::uint32_t SRCSLOTBITS = std::min(SRCSIZE * 8, (TRIMONV ? P::YZBITS : P::YZ1BITS) + P::YZBITS);
@@ -802,19 +1681,27 @@ namespace bitcash
                             const std::uint32_t SRCPREFMASK2 = (1 << SRCPREFBITS2) - 1;
                             indexerZ dst;
                             indexerT small;
+                            indexerL ldst;
+                            indexerTL lsmall;
+                            wcbufferZ* wc = stage(id, (std::uint64_t)live * DSTSIZE);
                             static std::uint32_t maxnnid = 0;
 
                             offset_t sumsize = 0;
                             std::uint8_t const* base = (std::uint8_t*)buckets;
                             std::uint8_t const* small0 = (std::uint8_t*)tbuckets[id];
-                            const std::uint32_t startvx = P::NY * id / threads;
-                            const std::uint32_t endvx = P::NY * (id + 1) / threads;
-                            for (std::uint32_t vx = startvx; vx < endvx; vx++) {
+                            std::uint8_t const* lbase = (std::uint8_t*)lanes;
+                            std::uint8_t const* lsmall0 = (std::uint8_t*)tlanes[id];
+                            for (std::uint32_t vx; (vx = nextrow(round)) < P::NX; ) {
                                 small.matrixu(0);
+                                if (INDEXED)
+                                    lsmall.matrixu(0);
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
                                     std::uint32_t uyz = 0;
                                     zbucketZ& zb = TRIMONV ? buckets[ux][vx] : buckets[vx][ux];
-                                    const std::uint8_t *readbig = zb.bytes, *endreadbig = readbig + zb.size;
+                                    if (prefetch_distance && ux + 1 < P::NX)
+                                        prefetch((TRIMONV ? buckets[ux + 1][vx] : buckets[vx][ux + 1]).bytes);
+                                    const std::uint8_t *readbig = zb.bytes, *endreadbig = readbig + zb.fill();
+                                    const std::uint32_t* readlane = INDEXED ? (TRIMONV ? lanes[ux][vx] : lanes[vx][ux]).words : nullptr;
                                     for (; readbig < endreadbig; readbig += SRCSIZE) {
                                         // bit        39..37    36..22     21..15     14..0
                                         // write      UYYYYY    UZZZZZ     VYYYYY     VZZZZ   within VX partition  if TRIMONV
@@ -834,22 +1721,39 @@ namespace bitcash
                                         if (TRIMONV)
                                             uyz &= ~P::ZMASK;
                                         small.index[vy] += SRCSIZE;
+                                        if (INDEXED)
+                                            lanestore(lsmall0, lsmall, vy, *readlane++);
                                     }
                                 }
                                 std::uint16_t* degs = (std::uint16_t*)tdegs[id];
                                 small.storeu(tbuckets + id, 0);
+                                if (spill(small) || (INDEXED && spill(lsmall)))
+                                    continue;
                                 TRIMONV ? dst.matrixv(vx) : dst.matrixu(vx);
+                                if (wc)
+                                    wc->begin(dst.index);
+                                if (INDEXED)
+                                    TRIMONV ? ldst.matrixv(vx) : ldst.matrixu(vx);
                                 std::uint32_t newnodeid = 0;
                                 std::uint32_t* renames = TRIMONV ? buckets[0][vx].renamev : buckets[vx][0].renameu;
                                 std::uint32_t* endrenames = renames + P::NZ1;
                                 for (std::uint32_t vy = 0; vy < P::NY; vy++) {
                                     memset(degs, 0xff, 2 * P::NZ);
                                     std::uint8_t *readsmall = tbuckets[id][vy].bytes, *endreadsmall = readsmall + tbuckets[id][vy].size;
-                                    for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += SRCSIZE)
+                                    const std::uint32_t dist = prefetch_distance * SRCSIZE;
+                                    if (dist && vy + 1 < P::NY)
+                                        prefetch(tbuckets[id][vy + 1].bytes);
+                                    for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += SRCSIZE) {
+                                        if (dist)
+                                            prefetch(degs + (*(std::uint32_t*)ahead(rdsmall, endreadsmall, dist) & P::ZMASK));
                                         degs[*(std::uint32_t*)rdsmall & P::ZMASK]++;
+                                    }
                                     std::uint32_t ux = 0;
                                     std::uint32_t nrenames = 0;
+                                    const std::uint32_t* readlane = INDEXED ? tlanes[id][vy].words : nullptr;
                                     for (std::uint8_t* rdsmall = readsmall; rdsmall < endreadsmall; rdsmall += SRCSIZE) {
+                                        if (dist)
+                                            prefetch(degs + (*(std::uint32_t*)ahead(rdsmall, endreadsmall, dist) & P::ZMASK));
                                         // bit        39..37    36..30     29..15     14..0
                                         // read       UXXXXX    UYYYYY     UZZZZZ     VZZZZ   within VX VY partition  if TRIMONV
                                         // bit            36...30     29...15     14..0
@@ -861,22 +1765,24 @@ namespace bitcash
                                             ux = e >> P::YZZ1BITS;
                                         const std::uint32_t vz = e & P::ZMASK;
                                         std::uint16_t vdeg = degs[vz];
+                                        const std::uint32_t nonce = INDEXED ? *readlane++ : 0;
                                         if (vdeg) {
                                             if (vdeg < 32) {
                                                 degs[vz] = vdeg = 32 + nrenames++;
                                                 *renames++ = vy << P::ZBITS | vz;
                                                 if (renames == endrenames) {
-                                                    endrenames += (TRIMONV ? sizeof(yzbucketZ) : sizeof(zbucketZ)) / sizeof(std::uint32_t);
+                                                    endrenames += (TRIMONV ? sizeof(xzbucketZ) : sizeof(zbucketZ)) / sizeof(std::uint32_t);
                                                     renames = endrenames - P::NZ1;
                                                 }
                                             }
                                             // bit       36..22     21..15     14..0
                                             // write     VYYZZ'     UYYYYY     UZZZZ   within UX partition  if TRIMONV
                                             if (TRIMONV)
-                                                *(std::uint64_t*)(base + dst.index[ux]) = ((std::uint64_t)(newnodeid + vdeg - 32) << P::YZBITS) | ((e >> P::ZBITS) & P::YZMASK);
+                                                emit<std::uint64_t>(base, dst, wc, ux, ((std::uint64_t)(newnodeid + vdeg - 32) << P::YZBITS) | ((e >> P::ZBITS) & P::YZMASK), DSTSIZE);
                                             else
-                                                *(std::uint32_t*)(base + dst.index[ux]) = ((newnodeid + vdeg - 32) << P::YZ1BITS) | ((e >> P::ZBITS) & P::YZ1MASK);
-                                            dst.index[ux] += DSTSIZE;
+                                                emit<std::uint32_t>(base, dst, wc, ux, ((newnodeid + vdeg - 32) << P::YZ1BITS) | ((e >> P::ZBITS) & P::YZ1MASK), DSTSIZE);
+                                            if (INDEXED)
+                                                lanestore(lbase, ldst, ux, nonce);
                                         }
                                     }
                                     newnodeid += nrenames;
@@ -886,162 +1792,343 @@ namespace bitcash
                                 }
                                 if (newnodeid > maxnnid)
                                     maxnnid = newnodeid;
+                                if (wc)
+                                    wc->end(base, dst.index);
                                 sumsize += TRIMONV ? dst.storev(buckets, vx) : dst.storeu(buckets, vx);
                             }
                             assert(maxnnid < P::NYZ1);
+                            spill(dst);
+                            if (INDEXED)
+                                spill(ldst);
                             tcounts[id] = sumsize / DSTSIZE;
                         }
 
-                    template <bool TRIMONV>
+                    template <bool TRIMONV, bool INDEXED>
                         void trimedges1(const std::uint32_t id, const std::uint32_t round)
                         {
                             indexerZ dst;
+                            indexerL ldst;
+                            wcbufferZ* wc = stage(id, (std::uint64_t)live * sizeof(std::uint32_t));
 
                             offset_t sumsize = 0;
                             std::uint8_t* degs = tdegs[id];
                             std::uint8_t const* base = (std::uint8_t*)buckets;
-                            const std::uint32_t startvx = P::NY * id / threads;
-                            const std::uint32_t endvx = P::NY * (id + 1) / threads;
-                            for (std::uint32_t vx = startvx; vx < endvx; vx++) {
+                            std::uint8_t const* lbase = (std::uint8_t*)lanes;
+                            for (std::uint32_t vx; (vx = nextrow(round)) < P::NX; ) {
                                 TRIMONV ? dst.matrixv(vx) : dst.matrixu(vx);
+                                if (wc)
+                                    wc->begin(dst.index);
+                                if (INDEXED)
+                                    TRIMONV ? ldst.matrixv(vx) : ldst.matrixu(vx);
                                 memset(degs, 0xff, P::NYZ1);
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
                                     zbucketZ& zb = TRIMONV ? buckets[ux][vx] : buckets[vx][ux];
-                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
-                                    for (; readbig < endreadbig; readbig++)
+                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.fill() / sizeof(std::uint32_t);
+                                    if (prefetch_distance && ux + 1 < P::NX)
+                                        prefetch((TRIMONV ? buckets[ux + 1][vx] : buckets[vx][ux + 1]).words);
+                                    for (; readbig < endreadbig; readbig++) {
+                                        if (prefetch_distance)
+                                            prefetch(degs + (*ahead(readbig, endreadbig, prefetch_distance) & P::YZ1MASK));
                                         degs[*readbig & P::YZ1MASK]++;
+                                    }
                                 }
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
                                     zbucketZ& zb = TRIMONV ? buckets[ux][vx] : buckets[vx][ux];
-                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
+                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.fill() / sizeof(std::uint32_t);
+                                    const std::uint32_t* readlane = INDEXED ? (TRIMONV ? lanes[ux][vx] : lanes[vx][ux]).words : nullptr;
+#if NSIPHASH == 16 || NSIPHASH == 8
+                                    // lanes and staged stores go slot by slot
+                                    if (!INDEXED && !wc)
+                                        readbig = survivors(readbig, endreadbig, degs, base, dst.index[ux]);
+#endif
                                     for (; readbig < endreadbig; readbig++) {
+                                        if (prefetch_distance)
+                                            prefetch(degs + (*ahead(readbig, endreadbig, prefetch_distance) & P::YZ1MASK));
                                         // bit       29..22    21..15     14..7     6..0
                                         // read      UYYYYY    UZZZZ'     VYYYY     VZZ'   within VX partition
                                         const std::uint32_t e = *readbig;
                                         const std::uint32_t vyz = e & P::YZ1MASK;
                                         // bit       29..22    21..15     14..7     6..0
                                         // write     VYYYYY    VZZZZ'     UYYYY     UZZ'   within UX partition
-                                        *(std::uint32_t*)(base + dst.index[ux]) = (vyz << P::YZ1BITS) | (e >> P::YZ1BITS);
-                                        dst.index[ux] += degs[vyz] ? sizeof(std::uint32_t) : 0;
+                                        emit<std::uint32_t>(base, dst, wc, ux, (vyz << P::YZ1BITS) | (e >> P::YZ1BITS), degs[vyz] ? sizeof(std::uint32_t) : 0);
+                                        if (INDEXED)
+                                            lanestore(lbase, ldst, ux, *readlane++, degs[vyz] ? sizeof(std::uint32_t) : 0);
                                     }
                                 }
+                                if (wc)
+                                    wc->end(base, dst.index);
                                 sumsize += TRIMONV ? dst.storev(buckets, vx) : dst.storeu(buckets, vx);
                             }
+                            spill(dst);
+                            if (INDEXED)
+                                spill(ldst);
                             tcounts[id] = sumsize / sizeof(std::uint32_t);
                         }
 
-                    template <bool TRIMONV>
+                    template <bool TRIMONV, bool INDEXED>
                         void trimrename1(const std::uint32_t id, const std::uint32_t round)
                         {
                             indexerZ dst;
+                            indexerL ldst;
+                            wcbufferZ* wc = stage(id, (std::uint64_t)live * sizeof(std::uint32_t));
                             static std::uint32_t maxnnid = 0;
 
                             offset_t sumsize = 0;
                             std::uint16_t* degs = (std::uint16_t*)tdegs[id];
                             std::uint8_t const* base = (std::uint8_t*)buckets;
-                            const std::uint32_t startvx = P::NY * id / threads;
-                            const std::uint32_t endvx = P::NY * (id + 1) / threads;
-                            for (std::uint32_t vx = startvx; vx < endvx; vx++) {
+                            std::uint8_t const* lbase = (std::uint8_t*)lanes;
+                            for (std::uint32_t vx; (vx = nextrow(round)) < P::NX; ) {
                                 TRIMONV ? dst.matrixv(vx) : dst.matrixu(vx);
+                                if (wc)
+                                    wc->begin(dst.index);
+                                if (INDEXED)
+                                    TRIMONV ? ldst.matrixv(vx) : ldst.matrixu(vx);
                                 memset(degs, 0xff, 2 * P::NYZ1);
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
                                     zbucketZ& zb = TRIMONV ? buckets[ux][vx] : buckets[vx][ux];
-                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
-                                    for (; readbig < endreadbig; readbig++)
+                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.fill() / sizeof(std::uint32_t);
+                                    if (prefetch_distance && ux + 1 < P::NX)
+                                        prefetch((TRIMONV ? buckets[ux + 1][vx] : buckets[vx][ux + 1]).words);
+                                    for (; readbig < endreadbig; readbig++) {
+                                        if (prefetch_distance)
+                                            prefetch(degs + (*ahead(readbig, endreadbig, prefetch_distance) & P::YZ1MASK));
                                         degs[*readbig & P::YZ1MASK]++;
+                                    }
                                 }
                                 std::uint32_t newnodeid = 0;
                                 std::uint32_t* renames = TRIMONV ? buckets[0][vx].renamev1 : buckets[vx][0].renameu1;
                                 std::uint32_t* endrenames = renames + P::NZ2;
                                 for (std::uint32_t ux = 0; ux < P::NX; ux++) {
                                     zbucketZ& zb = TRIMONV ? buckets[ux][vx] : buckets[vx][ux];
-                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
+                                    std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.fill() / sizeof(std::uint32_t);
+                                    const std::uint32_t* readlane = INDEXED ? (TRIMONV ? lanes[ux][vx] : lanes[vx][ux]).words : nullptr;
                                     for (; readbig < endreadbig; readbig++) {
+                                        if (prefetch_distance)
+                                            prefetch(degs + (*ahead(readbig, endreadbig, prefetch_distance) & P::YZ1MASK));
                                         // bit       29...15     14...0
                                         // read      UYYYZZ'     VYYZZ'   within VX partition
                                         const std::uint32_t e = *readbig;
                                         const std::uint32_t vyz = e & P::YZ1MASK;
                                         std::uint16_t vdeg = degs[vyz];
+                                        const std::uint32_t nonce = INDEXED ? *readlane++ : 0;
                                         if (vdeg) {
                                             if (vdeg < 32) {
                                                 degs[vyz] = vdeg = 32 + newnodeid++;
                                                 *renames++ = vyz;
                                                 if (renames == endrenames) {
-                                                    endrenames += (TRIMONV ? sizeof(yzbucketZ) : sizeof(zbucketZ)) / sizeof(std::uint32_t);
+                                                    endrenames += (TRIMONV ? sizeof(xzbucketZ) : sizeof(zbucketZ)) / sizeof(std::uint32_t);
                                                     renames = endrenames - P::NZ2;
                                                 }
                                             }
                                             // bit       25...15     14...0
                                             // write     VYYZZZ"     UYYZZ'   within UX partition
-                                            *(std::uint32_t*)(base + dst.index[ux]) = ((vdeg - 32) << (TRIMONV ? P::YZ1BITS : P::YZ2BITS)) | (e >> P::YZ1BITS);
-                                            dst.index[ux] += sizeof(std::uint32_t);
+                                            emit<std::uint32_t>(base, dst, wc, ux, ((vdeg - 32) << (TRIMONV ? P::YZ1BITS : P::YZ2BITS)) | (e >> P::YZ1BITS), sizeof(std::uint32_t));
+                                            if (INDEXED)
+                                                lanestore(lbase, ldst, ux, nonce);
                                         }
                                     }
                                 }
                                 if (newnodeid > maxnnid)
                                     maxnnid = newnodeid;
+                                if (wc)
+                                    wc->end(base, dst.index);
                                 sumsize += TRIMONV ? dst.storev(buckets, vx) : dst.storeu(buckets, vx);
                             }
                             assert(maxnnid < P::NYZ2);
+                            spill(dst);
+                            if (INDEXED)
+                                spill(ldst);
                             tcounts[id] = sumsize / sizeof(std::uint32_t);
                         }
 
+                    void resetrows()
+                    {
+                        for (std::uint32_t r = 0; r <= nTrims; r++) {
+                            rows[r].next.store(0, std::memory_order_relaxed);
+                        }
+                    }
+
+                    // rows are handed out one at a time, so a thread that falls
+                    // behind does not hold up the whole round. every row writes
+                    // to its own column of the matrix, so the result does not
+                    // depend on which thread gets which row.
+                    std::uint32_t nextrow(const std::uint32_t round)
+                    {
+                        return rows[round].next.fetch_add(1, std::memory_order_relaxed);
+                    }
+
                     void trim()
                     {
                         if (threads == 1) {
+                            begin();
                             trimmer(0);
                             return;
                         }
 
+                        for(auto& j : trim_async()) {
+                            j.wait();
+                        }
+                    }
+
+                    // start trimming on the pool, even with a single thread, and
+                    // leave the caller free until it waits on the jobs
+                    std::vector<std::future<void>> trim_async()
+                    {
+                        begin();
+
                         std::vector<std::future<void>> jobs;
                         for (int t = 0; t < threads; t++) {
                             jobs.push_back(
                                     pool.push([this, t](int id) {
-                                        etworker<offset_t, EDGEBITS, XBITS>(this, t);
+                                        etworker<offset_t, EDGEBITS, XBITS, YBITS>(this, t);
                                         }));
                         }
+                        return jobs;
+                    }
 
-                        for(auto& j : jobs) {
-                            j.wait();
+                    void begin()
+                    {
+                        resetrows();
+                        for (std::uint32_t t = 0; tstage && t < threads; t++)
+                            tstage[t].streamed = 0;
+                        // a graph abandoned before genVnodes cleared all rows
+                        // leaves marks behind
+                        if (nodebits && aborted)
+                            memset((void*)nodebits, 0, nodebitsbytes());
+                        aborted = false;
+                        overflowed.store(false, std::memory_order_relaxed);
+                        compressround = 0;
+                        finalround = 0;
+                        lastcount = 0;
+                        std::fill(round_seconds.begin(), round_seconds.end(), 0);
+                        round_start = std::chrono::steady_clock::now();
+                    }
+
+                    // called at the barrier that ends round
+                    void lap(const std::uint32_t round)
+                    {
+                        const auto now = std::chrono::steady_clock::now();
+                        round_seconds[round] = std::chrono::duration<double>(now - round_start).count();
+                        round_start = now;
+                    }
+
+                    // every rename pass hands out at most one new id per edge, so
+                    // the next pair can rename into limit ids once no row or
+                    // column of the matrix holds limit edges
+                    bool fits(const std::uint32_t round, const std::uint32_t limit) const
+                    {
+                        const std::uint32_t size = compressround ? sizeof(std::uint32_t)
+                            : round - 1 < P::EXPANDROUND ? P::BIGSIZE : P::BIGGERSIZE;
+                        const std::uint64_t most = (std::uint64_t)limit * size;
+                        for (std::uint32_t x = 0; x < P::NX; x++) {
+                            std::uint64_t row = 0;
+                            for (std::uint32_t y = 0; y < P::NX; y++)
+                                row += buckets[x][y].size;
+                            if (row >= most)
+                                return false;
+                        }
+                        for (std::uint32_t y = 0; y < P::NX; y++) {
+                            std::uint64_t col = 0;
+                            for (std::uint32_t x = 0; x < P::NX; x++)
+                                col += buckets[x][y].size;
+                            if (col >= most)
+                                return false;
                         }
+                        return true;
+                    }
+
+                    // pick what the round pair starting at round does. the compress
+                    // pair moves up to the first round that fits the renamed ids,
+                    // the final pair comes once a pair removes less than min_gain
+                    // of the edges. both stay within the fixed schedule.
+                    void plan(const std::uint32_t round)
+                    {
+                        const offset_t edges = live;
+                        if (!compressround) {
+                            const std::uint32_t earliest = P::EXPANDROUND < P::COMPRESSROUND ? P::EXPANDROUND + 2 : 2;
+                            if (round >= P::COMPRESSROUND || (round >= earliest && fits(round, P::NYZ1)))
+                                compressround = round;
+                        } else if (round >= nTrims - 2) {
+                            finalround = round;
+                        } else if (round > compressround
+                                && edges <= lastcount
+                                && lastcount - edges < lastcount * min_gain
+                                && fits(round, P::NYZ2)) {
+                            finalround = round;
+                        }
+                        lastcount = edges;
+                    }
+
+                    // wait for the round to end, false if the graph is to be abandoned
+                    bool sync(const std::uint32_t round)
+                    {
+                        barry->Wait([this, round] {
+                                lap(round - 1);
+                                aborted = overflowed.load(std::memory_order_relaxed)
+                                    || (epoch && epoch->load(std::memory_order_relaxed) != start_epoch);
+                                live = count();
+                                if (!aborted && !(round & 1))
+                                    plan(round);
+                                });
+                        return !aborted;
                     }
 
                     void trimmer(std::uint32_t id)
                     {
-                        genUnodes(id, 0);
-                        barry->Wait();
-                        genVnodes(id, 1);
-                        for (std::uint32_t round = 2; round < nTrims - 2; round += 2) {
-                            barry->Wait();
-                            if (round < P::COMPRESSROUND) {
-                                if (round < P::EXPANDROUND)
-                                    trimedges<P::BIGSIZE, P::BIGSIZE, true>(id, round);
-                                else if (round == P::EXPANDROUND)
-                                    trimedges<P::BIGSIZE, P::BIGGERSIZE, true>(id, round);
-                                else
-                                    trimedges<P::BIGGERSIZE, P::BIGGERSIZE, true>(id, round);
-                            } else if (round == P::COMPRESSROUND) {
-                                trimrename<P::BIGGERSIZE, P::BIGGERSIZE, true>(id, round);
-                            } else
-                                trimedges1<true>(id, round);
-                            barry->Wait();
-                            if (round < P::COMPRESSROUND) {
-                                if (round + 1 < P::EXPANDROUND)
-                                    trimedges<P::BIGSIZE, P::BIGSIZE, false>(id, round + 1);
-                                else if (round + 1 == P::EXPANDROUND)
-                                    trimedges<P::BIGSIZE, P::BIGGERSIZE, false>(id, round + 1);
-                                else
-                                    trimedges<P::BIGGERSIZE, P::BIGGERSIZE, false>(id, round + 1);
-                            } else if (round == P::COMPRESSROUND) {
-                                trimrename<P::BIGGERSIZE, sizeof(std::uint32_t), false>(id, round + 1);
-                            } else
-                                trimedges1<false>(id, round + 1);
-                        }
-                        barry->Wait();
-                        trimrename1<true>(id, nTrims - 2);
-                        barry->Wait();
-                        trimrename1<false>(id, nTrims - 1);
+                        // configs that cannot index only instantiate the plain rounds
+                        if (lanes)
+                            trimrounds<P::INDEXABLE>(id);
+                        else
+                            trimrounds<false>(id);
                     }
+
+                    template <bool INDEXED>
+                        void trimrounds(std::uint32_t id)
+                        {
+                            genUnodes(id, 0);
+                            if (!sync(1))
+                                return;
+                            genVnodes<INDEXED>(id, 1);
+                            std::uint32_t round = 2;
+                            for (;; round += 2) {
+                                if (!sync(round))
+                                    return;
+                                if (round == finalround)
+                                    break;
+                                if (!compressround) {
+                                    if (round < P::EXPANDROUND)
+                                        trimedges<P::BIGSIZE, P::BIGSIZE, true, INDEXED>(id, round);
+                                    else if (round == P::EXPANDROUND)
+                                        trimedges<P::BIGSIZE, P::BIGGERSIZE, true, INDEXED>(id, round);
+                                    else
+                                        trimedges<P::BIGGERSIZE, P::BIGGERSIZE, true, INDEXED>(id, round);
+                                } else if (round == compressround) {
+                                    trimrename<P::BIGGERSIZE, P::BIGGERSIZE, true, INDEXED>(id, round);
+                                } else
+                                    trimedges1<true, INDEXED>(id, round);
+                                if (!sync(round + 1))
+                                    return;
+                                if (!compressround) {
+                                    if (round + 1 < P::EXPANDROUND)
+                                        trimedges<P::BIGSIZE, P::BIGSIZE, false, INDEXED>(id, round + 1);
+                                    else if (round + 1 == P::EXPANDROUND)
+                                        trimedges<P::BIGSIZE, P::BIGGERSIZE, false, INDEXED>(id, round + 1);
+                                    else
+                                        trimedges<P::BIGGERSIZE, P::BIGGERSIZE, false, INDEXED>(id, round + 1);
+                                } else if (round == compressround) {
+                                    trimrename<P::BIGGERSIZE, sizeof(std::uint32_t), false, INDEXED>(id, round + 1);
+                                } else
+                                    trimedges1<false, INDEXED>(id, round + 1);
+                            }
+                            trimrename1<true, INDEXED>(id, round);
+                            if (!sync(round + 1))
+                                return;
+                            trimrename1<false, INDEXED>(id, round + 1);
+                            barry->Wait([this, round] {
+                                    lap(round + 1);
+                                    aborted = overflowed.load(std::memory_order_relaxed);
+                                    });
+                        }
             };
 
         int nonce_cmp(const void* a, const void* b)
@@ -1049,41 +2136,81 @@ namespace bitcash
             return *(std::uint32_t*)a - *(std::uint32_t*)b;
         }
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
             class solver_ctx
             {
                 public:
-                    using P = Params<EDGEBITS, XBITS>;
-                    using zbucket8P = zbucket8<EDGEBITS, XBITS>;
-                    using zbucket16P = zbucket16<EDGEBITS, XBITS>;
-                    using zbucket32P = zbucket32<EDGEBITS, XBITS>;
-                    using zbucketZ = zbucket<EDGEBITS, XBITS, P::ZBUCKETSIZE>;
-                    using yzbucketT = yzbucket<EDGEBITS, XBITS, P::TBUCKETSIZE>;
-
-                    edgetrimmer<offset_t, EDGEBITS, XBITS>* trimmer;
+                    using P = Params<EDGEBITS, XBITS, YBITS>;
+                    using zbucket8P = zbucket8<EDGEBITS, XBITS, YBITS>;
+                    using zbucket16P = zbucket16<EDGEBITS, XBITS, YBITS>;
+                    using zbucket32P = zbucket32<EDGEBITS, XBITS, YBITS>;
+                    using zbucketZ = zbucket<EDGEBITS, XBITS, YBITS, P::ZBUCKETSIZE>;
+                    using yzbucketT = yzbucket<EDGEBITS, XBITS, YBITS, P::TBUCKETSIZE>;
+
+                    using trimmer_t = edgetrimmer<offset_t, EDGEBITS, XBITS, YBITS>;
+
+                    trimmer_t* trimmer;
                     std::uint32_t* cuckoo = 0;
-                    std::vector<std::uint32_t> cycleus;
+                    std::vector<std::uint32_t> cycleus; // u node of every cycle edge, proofSize per cycle
                     std::vector<std::uint32_t> cyclevs;
-                    std::bitset<P::NXY> uxymap;
                     std::vector<std::uint32_t> sols; // concatanation of all proof's indices
+
+                    // open addressing hash of the u nodes of all cycle edges, so
+                    // one sweep over the nonces recovers every cycle of the graph
+                    struct CycleEdge
+                    {
+                        std::uint32_t u;
+                        std::uint32_t slot; // index into cycleus, cyclevs and sols
+                    };
+                    static const std::uint32_t NO_SLOT = ~0;
+                    std::vector<CycleEdge> cycleedges;
+                    std::uint32_t cyclebits = 0;
                     ctpl::thread_pool& pool;
                     size_t threads;
                     std::uint8_t proofSize;
+                    std::string headerhash; // to solve the graph again if trimming overflowed
+                    // run recovery on the calling thread, the pool is busy
+                    // trimming the next graph when pipelining
+                    bool recover_inline = false;
+
+                    // union-find forest over the nodes of the trimmed graph, parents
+                    // only ever point to lower ids. it splits the graph into
+                    // components that the cycle finding threads walk on their own.
+                    std::unique_ptr<std::atomic<std::uint32_t>[]> forest;
+
+                    // a cycle of proofSize found by a cycle finding thread
+                    struct Found
+                    {
+                        std::uint64_t edge; // position of the closing edge in the serial walk
+                        std::vector<std::uint32_t> us;
+                        std::vector<std::uint32_t> vs;
+                    };
 
                     solver_ctx(
                             ctpl::thread_pool& poolIn,
                             size_t threadsIn,
-                            const char* header,
-                            const std::uint32_t headerlen,
                             const std::uint32_t nTrims,
-                            const std::uint8_t proofSizeIn) : pool{poolIn}, threads{threadsIn}, proofSize{proofSizeIn}
+                            const SolverOptions& options) : pool{poolIn}, threads{threadsIn}, proofSize{0}
                     {
-                        trimmer = new edgetrimmer<offset_t, EDGEBITS, XBITS>(pool, threadsIn, nTrims);
+                        trimmer = new edgetrimmer<offset_t, EDGEBITS, XBITS, YBITS>(pool, threadsIn, nTrims, options);
+                        // a pipelined search runs on the calling thread while the pool
+                        // trims the next graph, so it keeps the serial walk
+                        if (threads > 1 && !options.pipeline) {
+                            forest.reset(new std::atomic<std::uint32_t>[P::CUCKOO_SIZE]);
+                        }
+                    }
 
-                        cycleus.reserve(proofSize);
-                        cyclevs.reserve(proofSize);
+                    // prepare the context for a new graph, keeping the trimmer buffers
+                    void reset(const char* header, const std::uint32_t headerlen, const std::uint8_t proofSizeIn)
+                    {
+                        proofSize = proofSizeIn;
+                        headerhash.assign(header, headerlen);
+                        cycleus.clear();
+                        cyclevs.clear();
+                        sols.clear();
 
                         setHeader(header, headerlen, &trimmer->sip_keys);
+                        trimmer->start_epoch = trimmer->epoch ? trimmer->epoch->load() : 0;
 
                         cuckoo = 0;
                     }
@@ -1093,25 +2220,50 @@ namespace bitcash
                         delete trimmer;
                     }
 
-                    std::uint64_t sharedbytes() const
+                    static std::uint64_t sharedbytes()
                     {
-                        return sizeof(matrix<EDGEBITS, XBITS, P::ZBUCKETSIZE>);
+                        return sizeof(matrix<EDGEBITS, XBITS, YBITS, P::ZBUCKETSIZE>);
                     }
 
-                    std::uint32_t threadbytes() const
+                    // per thread degree and z counters, hit at random while trimming
+                    static std::uint32_t counterbytes()
+                    {
+                        return sizeof(zbucket8P) + sizeof(zbucket16P) + sizeof(zbucket32P);
+                    }
+
+                    static std::uint32_t threadbytes()
                     {
                         return sizeof(yzbucketT) + sizeof(zbucket8P) + sizeof(zbucket16P) + sizeof(zbucket32P);
                     }
 
+                    static std::uint64_t forestbytes()
+                    {
+                        return (std::uint64_t)P::CUCKOO_SIZE * sizeof(std::uint32_t);
+                    }
+
+                    // run f(t) for every thread t on the pool and wait for all of them
+                    template <typename F>
+                        void run(F&& f)
+                        {
+                            std::vector<std::future<void>> jobs;
+                            for (size_t t = 0; t < threads; t++) {
+                                jobs.push_back(pool.push([&f, t](int) { f(t); }));
+                            }
+
+                            for (auto& j : jobs) {
+                                j.wait();
+                            }
+                        }
+
                     void recordedge(const std::uint32_t i, const std::uint32_t u2, const std::uint32_t v2)
                     {
                         const std::uint32_t u1 = u2 / 2;
                         const std::uint32_t ux = u1 >> P::YZ2BITS;
-                        std::uint32_t uyz = trimmer->buckets[ux][(u1 >> P::Z2BITS) & P::YMASK].renameu1[u1 & P::Z2MASK];
+                        std::uint32_t uyz = trimmer->buckets[ux][(u1 >> P::Z2BITS) & P::XMASK].renameu1[u1 & P::Z2MASK];
                         assert(uyz < P::NYZ1);
                         const std::uint32_t v1 = v2 / 2;
                         const std::uint32_t vx = v1 >> P::YZ2BITS;
-                        std::uint32_t vyz = trimmer->buckets[(v1 >> P::Z2BITS) & P::YMASK][vx].renamev1[v1 & P::Z2MASK];
+                        std::uint32_t vyz = trimmer->buckets[(v1 >> P::Z2BITS) & P::XMASK][vx].renamev1[v1 & P::Z2MASK];
                         assert(vyz < P::NYZ1);
 
                         if (P::COMPRESSROUND > 0) {
@@ -1124,35 +2276,84 @@ namespace bitcash
 
                         cycleus[i] = u / 2;
                         cyclevs[i] = v / 2;
-                        uxymap[u / 2 >> P::ZBITS] = 1;
+                        if (trimmer->lanes)
+                            sols[i] = lanenonce(u2, v2);
                     }
 
+                    // nonce of the trimmed edge u2 v2, from the lane beside its bucket
+                    std::uint32_t lanenonce(const std::uint32_t u2, const std::uint32_t v2) const
+                    {
+                        const std::uint32_t u1 = u2 / 2;
+                        const std::uint32_t v1 = v2 / 2;
+                        const std::uint32_t ux = u1 >> P::YZ2BITS;
+                        const std::uint32_t vx = v1 >> P::YZ2BITS;
+                        const std::uint32_t e = ((u1 & P::YZ2MASK) << P::YZ2BITS) | (v1 & P::YZ2MASK);
+                        const zbucketZ& zb = trimmer->buckets[ux][vx];
+                        for (std::uint32_t i = 0; i < zb.size / sizeof(std::uint32_t); i++) {
+                            if (zb.words[i] == e)
+                                return trimmer->lanes[ux][vx].words[i];
+                        }
+                        assert(false);
+                        return 0;
+                    }
+
+                    // records a cycle, its nonces are recovered with all others by recover
                     void solution(const std::uint32_t* us, std::uint32_t nu, const std::uint32_t* vs, std::uint32_t nv)
                     {
-                        std::uint32_t ni = 0;
+                        std::uint32_t ni = sols.size();
+                        cycleus.resize(ni + proofSize);
+                        cyclevs.resize(ni + proofSize);
+                        sols.resize(ni + proofSize);
+
                         recordedge(ni++, *us, *vs);
                         while (nu--)
                             recordedge(ni++, us[(nu + 1) & ~1], us[nu | 1]); // u's in even position; v's in odd
                         while (nv--)
                             recordedge(ni++, vs[nv | 1], vs[(nv + 1) & ~1]); // u's in odd position; v's in even
+                    }
 
-                        sols.resize(sols.size() + proofSize);
+                    std::uint32_t cyclehash(const std::uint32_t u) const
+                    {
+                        return (u * 2654435761u) >> (32 - cyclebits);
+                    }
 
-                        std::vector<std::future<void>> jobs;
-                        for (size_t t = 0; t < threads; t++) {
-                            jobs.push_back(
-                                    pool.push(
-                                        [this, t](int id) {
-                                            matchworker<offset_t, EDGEBITS, XBITS>(this, t);
-                                        }));
+                    // fills in the nonces of every recorded cycle in a single sweep
+                    void recover()
+                    {
+                        // at most a quarter full, most lookups end on an empty entry
+                        for (cyclebits = 4; (1u << cyclebits) < 4 * cycleus.size(); cyclebits++)
+                            ;
+                        cycleedges.assign(1u << cyclebits, CycleEdge{0, NO_SLOT});
+                        const std::uint32_t mask = (1u << cyclebits) - 1;
+                        for (std::uint32_t slot = 0; slot < cycleus.size(); slot++) {
+                            std::uint32_t i = cyclehash(cycleus[slot]);
+                            while (cycleedges[i].slot != NO_SLOT)
+                                i = (i + 1) & mask;
+                            cycleedges[i] = CycleEdge{cycleus[slot], slot};
                         }
 
-                        for (auto& j : jobs) {
-                            j.wait();
+                        trimmer->resetrows();
+                        if (recover_inline) {
+                            matchUnodes(0);
+                        } else {
+                            run([this](size_t t) { matchworker<offset_t, EDGEBITS, XBITS, YBITS>(this, t); });
                         }
+                    }
 
-                        auto start = sols.begin() + (sols.size() - proofSize);
-                        std::sort(start, start + proofSize); 
+                    // the cycle edges whose u node is nodeu, the v node is only
+                    // hashed once one is found
+                    void match(const std::uint32_t nodeu, const std::uint32_t edge)
+                    {
+                        const std::uint32_t mask = (1u << cyclebits) - 1;
+                        std::uint32_t nodev = CUCKOO_NIL;
+                        for (std::uint32_t i = cyclehash(nodeu); cycleedges[i].slot != NO_SLOT; i = (i + 1) & mask) {
+                            if (cycleedges[i].u != nodeu)
+                                continue;
+                            if (nodev == CUCKOO_NIL)
+                                nodev = _sipnode(&trimmer->sip_keys, P::EDGEMASK, edge, 1);
+                            if (cyclevs[cycleedges[i].slot] == nodev)
+                                sols[cycleedges[i].slot] = edge;
+                        }
                     }
 
                     static const std::uint32_t CUCKOO_NIL = ~0;
@@ -1171,70 +2372,185 @@ namespace bitcash
                         return nu - 1;
                     }
 
+                    // adds the edge u0 v0 to the cuckoo forest, or if its nodes are
+                    // already connected returns the length of the cycle it closes,
+                    // left in us[0..nu] and vs[0..nv]
+                    std::uint32_t addedge(
+                            const std::uint32_t u0,
+                            const std::uint32_t v0,
+                            std::uint32_t* us,
+                            std::uint32_t& nu,
+                            std::uint32_t* vs,
+                            std::uint32_t& nv)
+                    {
+                        nu = path(u0, us);
+                        nv = path(v0, vs);
+                        if (us[nu] == vs[nv]) {
+                            const std::uint32_t min = nu < nv ? nu : nv;
+                            for (nu -= min, nv -= min; us[nu] != vs[nv]; nu++, nv++)
+                                ;
+                            return nu + nv + 1;
+                        } else if (nu < nv) {
+                            while (nu--)
+                                cuckoo[us[nu + 1]] = us[nu];
+                            cuckoo[u0] = v0;
+                        } else {
+                            while (nv--)
+                                cuckoo[vs[nv + 1]] = vs[nv];
+                            cuckoo[v0] = u0;
+                        }
+                        return 0;
+                    }
+
+                    // calls f(u0, v0) on every surviving edge, in the same order every time
+                    template <typename F>
+                        void edges(F&& f) const
+                        {
+                            for (std::uint32_t vx = 0; vx < P::NX; vx++) {
+                                for (std::uint32_t ux = 0; ux < P::NX; ux++) {
+                                    const zbucketZ& zb = trimmer->buckets[ux][vx];
+                                    const std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
+                                    for (; readbig < endreadbig; readbig++) {
+                                        // bit        21..11     10...0
+                                        // write      UYYZZZ'    VYYZZ'   within VX partition
+                                        const std::uint32_t e = *readbig;
+                                        const std::uint32_t uxyz = (ux << P::YZ2BITS) | (e >> P::YZ2BITS);
+                                        const std::uint32_t vxyz = (vx << P::YZ2BITS) | (e & P::YZ2MASK);
+                                        f(uxyz << 1, (vxyz << 1) | 1);
+                                    }
+                                }
+                            }
+                        }
+
                     bool findcycles()
                     {
                         std::uint32_t us[MAXPATHLEN], vs[MAXPATHLEN];
 
                         bool found = false;
-                        for (std::uint32_t vx = 0; vx < P::NX; vx++) {
-                            for (std::uint32_t ux = 0; ux < P::NX; ux++) {
-                                zbucketZ& zb = trimmer->buckets[ux][vx];
-                                std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
-                                for (; readbig < endreadbig; readbig++) {
-                                    // bit        21..11     10...0
-                                    // write      UYYZZZ'    VYYZZ'   within VX partition
-                                    const std::uint32_t e = *readbig;
-                                    const std::uint32_t uxyz = (ux << P::YZ2BITS) | (e >> P::YZ2BITS);
-                                    const std::uint32_t vxyz = (vx << P::YZ2BITS) | (e & P::YZ2MASK);
-
-                                    const std::uint32_t u0 = uxyz << 1, v0 = (vxyz << 1) | 1;
-                                    if (u0 != CUCKOO_NIL) {
-                                        std::uint32_t nu = path(u0, us);
-                                        std::uint32_t nv = path(v0, vs);
-                                        if (us[nu] == vs[nv]) {
-                                            const std::uint32_t min = nu < nv ? nu : nv;
-                                            for (nu -= min, nv -= min; us[nu] != vs[nv]; nu++, nv++)
-                                                ;
-                                            const std::uint32_t len = nu + nv + 1;
-                                            if (len == proofSize) {
-                                                solution(us, nu, vs, nv);
-                                                found = true;
-                                            }
-                                        } else if (nu < nv) {
-                                            while (nu--)
-                                                cuckoo[us[nu + 1]] = us[nu];
-                                            cuckoo[u0] = v0;
-                                        } else {
-                                            while (nv--)
-                                                cuckoo[vs[nv + 1]] = vs[nv];
-                                            cuckoo[v0] = u0;
+                        edges([&](const std::uint32_t u0, const std::uint32_t v0) {
+                                if (u0 != CUCKOO_NIL) {
+                                    std::uint32_t nu, nv;
+                                    if (addedge(u0, v0, us, nu, vs, nv) == proofSize) {
+                                        solution(us, nu, vs, nv);
+                                        found = true;
+                                    }
+                                }
+                                });
+
+                        return found;
+                    }
+
+                    std::uint32_t root(std::uint32_t x) const
+                    {
+                        for (std::uint32_t p; (p = forest[x].load(std::memory_order_relaxed)) != CUCKOO_NIL; x = p)
+                            ;
+                        return x;
+                    }
+
+                    void unite(std::uint32_t a, std::uint32_t b)
+                    {
+                        for (;;) {
+                            a = root(a);
+                            b = root(b);
+                            if (a == b)
+                                return;
+                            if (a < b)
+                                std::swap(a, b);
+                            std::uint32_t nil = CUCKOO_NIL;
+                            if (forest[a].compare_exchange_weak(nil, b))
+                                return;
+                        }
+                    }
+
+                    // the cuckoo walk of an edge only depends on the earlier edges of
+                    // its component. so the components are unioned in parallel, each
+                    // thread then walks all edges of the components hashed to it in
+                    // the serial order, and the cycles are handed to recovery in the
+                    // order the serial walk finds them.
+                    bool findcycles_parallel()
+                    {
+                        run([this](size_t t) {
+                                for (std::uint32_t x = P::CUCKOO_SIZE * t / threads; x < P::CUCKOO_SIZE * (t + 1) / threads; x++)
+                                    forest[x].store(CUCKOO_NIL, std::memory_order_relaxed);
+                                });
+
+                        run([this](size_t t) {
+                                for (std::uint32_t vx = P::NX * t / threads; vx < P::NX * (t + 1) / threads; vx++) {
+                                    for (std::uint32_t ux = 0; ux < P::NX; ux++) {
+                                        const zbucketZ& zb = trimmer->buckets[ux][vx];
+                                        const std::uint32_t *readbig = zb.words, *endreadbig = readbig + zb.size / sizeof(std::uint32_t);
+                                        for (; readbig < endreadbig; readbig++) {
+                                            const std::uint32_t e = *readbig;
+                                            unite(((ux << P::YZ2BITS) | (e >> P::YZ2BITS)) << 1, ((vx << P::YZ2BITS) | (e & P::YZ2MASK)) << 1 | 1);
                                         }
                                     }
                                 }
-                            }
+                                });
+
+                        // point every node straight at its root
+                        run([this](size_t t) {
+                                for (std::uint32_t x = P::CUCKOO_SIZE * t / threads; x < P::CUCKOO_SIZE * (t + 1) / threads; x++) {
+                                    if (forest[x].load(std::memory_order_relaxed) != CUCKOO_NIL)
+                                        forest[x].store(root(x), std::memory_order_relaxed);
+                                }
+                                });
+
+                        std::vector<std::vector<Found>> founds(threads);
+                        run([this, &founds](size_t t) {
+                                std::vector<std::uint32_t> us(MAXPATHLEN), vs(MAXPATHLEN);
+                                std::uint64_t edge = 0;
+                                edges([&](const std::uint32_t u0, const std::uint32_t v0) {
+                                        if (u0 != CUCKOO_NIL && ((std::uint64_t)(root(u0) * 2654435761u) * threads >> 32) == t) {
+                                            std::uint32_t nu, nv;
+                                            if (addedge(u0, v0, us.data(), nu, vs.data(), nv) == proofSize) {
+                                                founds[t].push_back({edge, {us.begin(), us.begin() + nu + 1}, {vs.begin(), vs.begin() + nv + 1}});
+                                            }
+                                        }
+                                        edge++;
+                                        });
+                                });
+
+                        std::vector<Found> all;
+                        for (auto& f : founds) {
+                            std::move(f.begin(), f.end(), std::back_inserter(all));
                         }
+                        std::sort(all.begin(), all.end(), [](const Found& a, const Found& b) { return a.edge < b.edge; });
 
-                        return found;
+                        for (auto& f : all) {
+                            solution(f.us.data(), f.us.size() - 1, f.vs.data(), f.vs.size() - 1);
+                        }
+                        return !all.empty();
                     }
 
                     bool solve()
                     {
-                        assert((std::uint64_t)P::CUCKOO_SIZE * sizeof(std::uint32_t) <= trimmer->threads * sizeof(yzbucketT));
                         trimmer->trim();
+                        if (trimmer->aborted) {
+                            return false;
+                        }
+                        return search();
+                    }
+
+                    // find cycles in the graph left by trimming
+                    bool search()
+                    {
+                        assert((std::uint64_t)P::CUCKOO_SIZE * sizeof(std::uint32_t) <= trimmer->threads * sizeof(yzbucketT));
                         cuckoo = (std::uint32_t*)trimmer->tbuckets;
                         memset(cuckoo, CUCKOO_NIL, P::CUCKOO_SIZE * sizeof(std::uint32_t));
 
-                        return findcycles();
+                        const bool found = forest ? findcycles_parallel() : findcycles();
+                        // with nonce lanes recordedge has read the nonces already
+                        if (found && !trimmer->lanes)
+                            recover();
+
+                        for (auto start = sols.begin(); start != sols.end(); start += proofSize) {
+                            std::sort(start, start + proofSize);
+                        }
+                        return found;
                     }
 
                     void* matchUnodes(std::uint32_t threadId)
                     {
-                        const std::uint32_t starty = P::NY * threadId / trimmer->threads;
-                        const std::uint32_t endy = P::NY * (threadId + 1) / trimmer->threads;
-
-                        std::uint32_t edge = starty << P::YZBITS;
-                        std::uint32_t endedge = edge + P::NYZ;
-
 #if NSIPHASH == 8
                         static const __m256i vnodemask = {P::EDGEMASK, P::EDGEMASK, P::EDGEMASK, P::EDGEMASK};
                         const __m256i vinit = _mm256_set_epi64x(
@@ -1243,25 +2559,53 @@ namespace bitcash
                                 trimmer->sip_keys.k1 ^ 0x646f72616e646f6dULL,
                                 trimmer->sip_keys.k0 ^ 0x736f6d6570736575ULL);
                         __m256i v0, v1, v2, v3, v4, v5, v6, v7;
-                        const std::uint32_t e2 = 2 * edge;
-                        __m256i vpacket0 = _mm256_set_epi64x(e2 + 6, e2 + 4, e2 + 2, e2 + 0);
-                        __m256i vpacket1 = _mm256_set_epi64x(e2 + 14, e2 + 12, e2 + 10, e2 + 8);
+                        __m256i vpacket0, vpacket1;
                         static const __m256i vpacketinc = {16, 16, 16, 16};
+#elif NSIPHASH == 16
+                        const __m512i vnodemask = _mm512_set1_epi64(P::EDGEMASK);
+                        const __m512i vinit0 = _mm512_set1_epi64(trimmer->sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                        const __m512i vinit1 = _mm512_set1_epi64(trimmer->sip_keys.k1 ^ 0x646f72616e646f6dULL);
+                        const __m512i vinit2 = _mm512_set1_epi64(trimmer->sip_keys.k0 ^ 0x6c7967656e657261ULL);
+                        const __m512i vinit3 = _mm512_set1_epi64(trimmer->sip_keys.k1 ^ 0x7465646279746573ULL);
+                        const __m512i vff = _mm512_set1_epi64(0xff);
+                        __m512i v0, v1, v2, v3, v4, v5, v6, v7;
+                        __m512i vpacket0, vpacket1;
+                        const __m512i vpacketinc = _mm512_set1_epi64(32);
+                        alignas(64) std::uint32_t us[NSIPHASH];
+#elif NSIPHASH == 4
+                        const __m128i vnodemask = _mm_set1_epi64x(P::EDGEMASK);
+                        const __m128i vinit0 = _mm_set1_epi64x(trimmer->sip_keys.k0 ^ 0x736f6d6570736575ULL);
+                        const __m128i vinit1 = _mm_set1_epi64x(trimmer->sip_keys.k1 ^ 0x646f72616e646f6dULL);
+                        const __m128i vinit2 = _mm_set1_epi64x(trimmer->sip_keys.k0 ^ 0x6c7967656e657261ULL);
+                        const __m128i vinit3 = _mm_set1_epi64x(trimmer->sip_keys.k1 ^ 0x7465646279746573ULL);
+                        const __m128i vff = _mm_set1_epi64x(0xff);
+                        __m128i v0, v1, v2, v3, v4, v5, v6, v7;
+                        __m128i vpacket0, vpacket1;
+                        const __m128i vpacketinc = _mm_set1_epi64x(8);
+                        alignas(16) std::uint64_t us[NSIPHASH];
 #endif
 
-                        for (std::uint32_t my = starty; my < endy; my++, endedge += P::NYZ) {
+                        for (std::uint32_t my; (my = trimmer->nextrow(trimmer->nTrims)) < P::NX; ) {
+                            std::uint32_t edge = my << P::YZBITS;
+                            const std::uint32_t endedge = edge + P::NYZ;
+#if NSIPHASH == 8
+                            const std::uint32_t e2 = 2 * edge;
+                            vpacket0 = _mm256_set_epi64x(e2 + 6, e2 + 4, e2 + 2, e2 + 0);
+                            vpacket1 = _mm256_set_epi64x(e2 + 14, e2 + 12, e2 + 10, e2 + 8);
+#elif NSIPHASH == 16
+                            const std::uint32_t e2 = 2 * edge;
+                            vpacket0 = _mm512_set_epi64(e2 + 14, e2 + 12, e2 + 10, e2 + 8, e2 + 6, e2 + 4, e2 + 2, e2 + 0);
+                            vpacket1 = _mm512_set_epi64(e2 + 30, e2 + 28, e2 + 26, e2 + 24, e2 + 22, e2 + 20, e2 + 18, e2 + 16);
+#elif NSIPHASH == 4
+                            const std::uint32_t e2 = 2 * edge;
+                            vpacket0 = _mm_set_epi64x(e2 + 2, e2 + 0);
+                            vpacket1 = _mm_set_epi64x(e2 + 6, e2 + 4);
+#endif
                             for (; edge < endedge; edge += NSIPHASH) {
                                 // bit        28..21     20..13    12..0
                                 // node       XXXXXX     YYYYYY    ZZZZZ
 #if NSIPHASH == 1
-                                const std::uint32_t nodeu = _sipnode(&trimmer->sip_keys, P::EDGEMASK, edge, 0);
-                                if (uxymap[nodeu >> P::ZBITS]) {
-                                    for (std::uint32_t j = 0; j < proofSize; j++) {
-                                        if (cycleus[j] == nodeu && cyclevs[j] == _sipnode(&trimmer->sip_keys, P::EDGEMASK, edge, 1)) {
-                                            sols[sols.size() - proofSize + j] = edge;
-                                        }
-                                    }
-                                }
+                                match(_sipnode(&trimmer->sip_keys, P::EDGEMASK, edge, 0), edge);
                                 // bit        39..21     20..13    12..0
                                 // write        edge     YYYYYY    ZZZZZ
 #elif NSIPHASH == 8
@@ -1293,28 +2637,78 @@ namespace bitcash
                                 vpacket1 = _mm256_add_epi64(vpacket1, vpacketinc);
                                 v0 = v0 & vnodemask;
                                 v4 = v4 & vnodemask;
-                                v1 = _mm256_srli_epi64(v0, P::ZBITS);
-                                v5 = _mm256_srli_epi64(v4, P::ZBITS);
-
-                                std::uint32_t uxy;
-#define MATCH(i, v, x, w)                                                                                  \
-                                uxy = _mm256_extract_epi32(v, x);                                                                      \
-                                if (uxymap[uxy]) {                                                                                     \
-                                    std::uint32_t u = _mm256_extract_epi32(w, x);                                                           \
-                                    for (std::uint32_t j = 0; j < proofSize; j++) {                                                         \
-                                        if (cycleus[j] == u && cyclevs[j] == _sipnode(&trimmer->sip_keys, P::EDGEMASK, edge + i, 1)) { \
-                                            sols[sols.size() - proofSize + j] = edge + i;                                              \
-                                        }                                                                                              \
-                                    }                                                                                                  \
+
+#define MATCH(i, x, w) match(_mm256_extract_epi32(w, x), edge + i)
+                                MATCH(0, 0, v0);
+                                MATCH(1, 2, v0);
+                                MATCH(2, 4, v0);
+                                MATCH(3, 6, v0);
+                                MATCH(4, 0, v4);
+                                MATCH(5, 2, v4);
+                                MATCH(6, 4, v4);
+                                MATCH(7, 6, v4);
+#elif NSIPHASH == 16
+                                v0 = v4 = vinit0;
+                                v1 = v5 = vinit1;
+                                v2 = v6 = vinit2;
+                                v3 = v7 = vinit3;
+
+                                v3 = XORX16(v3, vpacket0);
+                                v7 = XORX16(v7, vpacket1);
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                v0 = XORX16(v0, vpacket0);
+                                v4 = XORX16(v4, vpacket1);
+                                v2 = XORX16(v2, vff);
+                                v6 = XORX16(v6, vff);
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                SIPROUNDX16;
+                                v0 = XORX16(XORX16(v0, v1), XORX16(v2, v3));
+                                v4 = XORX16(XORX16(v4, v5), XORX16(v6, v7));
+
+                                vpacket0 = ADDX16(vpacket0, vpacketinc);
+                                vpacket1 = ADDX16(vpacket1, vpacketinc);
+                                v0 = _mm512_and_si512(v0, vnodemask);
+                                v4 = _mm512_and_si512(v4, vnodemask);
+
+                                _mm256_store_si256((__m256i*)us, _mm512_cvtepi64_epi32(v0));
+                                _mm256_store_si256((__m256i*)(us + 8), _mm512_cvtepi64_epi32(v4));
+                                for (std::uint32_t i = 0; i < NSIPHASH; i++) {
+                                    match(us[i], edge + i);
+                                }
+#elif NSIPHASH == 4
+                                v0 = v4 = vinit0;
+                                v1 = v5 = vinit1;
+                                v2 = v6 = vinit2;
+                                v3 = v7 = vinit3;
+
+                                v3 = XORX4(v3, vpacket0);
+                                v7 = XORX4(v7, vpacket1);
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                v0 = XORX4(v0, vpacket0);
+                                v4 = XORX4(v4, vpacket1);
+                                v2 = XORX4(v2, vff);
+                                v6 = XORX4(v6, vff);
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                SIPROUNDX4;
+                                v0 = XORX4(XORX4(v0, v1), XORX4(v2, v3));
+                                v4 = XORX4(XORX4(v4, v5), XORX4(v6, v7));
+
+                                vpacket0 = ADDX4(vpacket0, vpacketinc);
+                                vpacket1 = ADDX4(vpacket1, vpacketinc);
+                                v0 = _mm_and_si128(v0, vnodemask);
+                                v4 = _mm_and_si128(v4, vnodemask);
+
+                                _mm_store_si128((__m128i*)us, v0);
+                                _mm_store_si128((__m128i*)(us + 2), v4);
+                                for (std::uint32_t i = 0; i < NSIPHASH; i++) {
+                                    match(us[i], edge + i);
                                 }
-                                MATCH(0, v1, 0, v0);
-                                MATCH(1, v1, 2, v0);
-                                MATCH(2, v1, 4, v0);
-                                MATCH(3, v1, 6, v0);
-                                MATCH(4, v5, 0, v4);
-                                MATCH(5, v5, 2, v4);
-                                MATCH(6, v5, 4, v4);
-                                MATCH(7, v5, 6, v4);
 #else
 #error not implemented
 #endif
@@ -1325,77 +2719,490 @@ namespace bitcash
                     }
             };
 
-        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS>
-            bool run(
-                    const char* hex_header_hash,
-                    uint32_t hex_header_hash_len,
-                    std::uint8_t proofSize,
-                    Cycles& cycles,
-                    size_t threads,
-                    ctpl::thread_pool& pool)
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            class mean_solver : public Solver::Impl
             {
-                assert(hex_header_hash != nullptr);
-                assert(hex_header_hash_len > 0);
-                assert(EDGEBITS >= MIN_EDGE_BITS && EDGEBITS <= MAX_EDGE_BITS);
-
-                std::uint32_t nTrims = EDGEBITS >= 30 ? 96 : 68;
-
-                solver_ctx<offset_t, EDGEBITS, XBITS> ctx{
-                    pool,
-                        threads,
-                        hex_header_hash,
-                        static_cast<std::uint32_t>(hex_header_hash_len),
-                        nTrims,
-                        proofSize};
-
-                bool found = ctx.solve();
-
-                if (found) {
-                    for(int i = 0; i < ctx.sols.size() / proofSize; i++) {
-                        Cycle cycle;
-                        copy(
-                                ctx.sols.begin() + (i * proofSize),
-                                ctx.sols.begin() + (i * proofSize) + proofSize,
-                                inserter(cycle, cycle.begin()));
-                        cycles.emplace_back(cycle);
+                public:
+                    using ctx_t = solver_ctx<offset_t, EDGEBITS, XBITS, YBITS>;
+
+                    mean_solver(size_t threads, ctpl::thread_pool& pool, const SolverOptions& options) :
+                        ctx{pool, threads, EDGEBITS >= 30 ? 96u : 68u, options},
+                        threads{threads},
+                        pool{pool},
+                        options{options}
+                    {
+                        static_assert(EDGEBITS >= MIN_EDGE_BITS && EDGEBITS <= MAX_EDGE_BITS, "unsupported EDGEBITS");
+
+                        arena[0] = &ctx;
+                        arena[1] = nullptr;
+                        if (options.pipeline) {
+                            // the second arena is searched while the first one is trimmed
+                            // and the other way around
+                            ctx2 = std::make_unique<ctx_t>(pool, threads, EDGEBITS >= 30 ? 96u : 68u, options);
+                            arena[1] = ctx2.get();
+                            ctx.recover_inline = true;
+                            ctx2->recover_inline = true;
+                        }
+
+                        _stats.isa = COMPILED_ISA;
+                        _stats.xbits = XBITS;
+                        _stats.ybits = YBITS;
+                        _stats.index_edges = options.index_edges;
+                        _stats.stream_stores = options.stream_stores;
+                        _stats.fuse_degrees = options.fuse_degrees;
+                        _stats.prefetch_distance = ctx.trimmer->prefetch_distance;
+                        _stats.backing = ctx.trimmer->buckets_backing;
+                        _stats.memory_bytes = bytes(threads, options);
+                        _stats.pipeline = options.pipeline;
                     }
+
+                    // the lean solver a graph that overflowed falls back to is
+                    // counted up front, it is made on the first overflow
+                    static std::uint64_t bytes(size_t threads, const SolverOptions& options)
+                    {
+                        const std::uint64_t fallback = lean_solver_bytes(EDGEBITS);
+                        const std::uint64_t lanes = options.index_edges ? ctx_t::trimmer_t::lanesbytes(threads) : 0;
+                        const std::uint64_t stage = options.stream_stores ? threads * sizeof(typename ctx_t::trimmer_t::wcbufferZ) : 0;
+                        const std::uint64_t marks = options.fuse_degrees ? ctx_t::trimmer_t::nodebitsbytes() : 0;
+                        if (options.pipeline) {
+                            return 2 * (ctx_t::sharedbytes() + threads * ctx_t::threadbytes() + lanes + stage + marks) + fallback;
+                        }
+                        return ctx_t::sharedbytes() + threads * ctx_t::threadbytes() + lanes + stage + marks + (threads > 1 ? ctx_t::forestbytes() : 0) + fallback;
+                    }
+
+                    ~mean_solver()
+                    {
+                        // the pool must not be left trimming into freed buckets
+                        for (auto& j : trimming) {
+                            j.wait();
+                        }
+                    }
+
+                    bool solve(
+                            const char* hex_header_hash,
+                            uint32_t hex_header_hash_len,
+                            std::uint8_t proofSize,
+                            Cycles& cycles) override
+                    {
+                        assert(hex_header_hash != nullptr);
+                        assert(hex_header_hash_len > 0);
+
+                        // a pending pipelined graph stays in its arena for flush
+                        ctx_t& c = *arena[pending ? next : 0];
+                        c.reset(hex_header_hash, hex_header_hash_len, proofSize);
+
+                        bool found = c.solve();
+                        if (c.trimmer->overflowed) {
+                            return relax(c, cycles);
+                        }
+                        _cancelled = c.trimmer->aborted;
+                        planned(c);
+                        return collect(c, found, cycles);
+                    }
+
+                    bool solve_next(
+                            const char* hex_header_hash,
+                            uint32_t hex_header_hash_len,
+                            std::uint8_t proofSize,
+                            Cycles& cycles) override
+                    {
+                        assert(hex_header_hash != nullptr);
+                        assert(hex_header_hash_len > 0);
+
+                        if (!arena[1]) {
+                            throw std::runtime_error{"solve_next: solver was created without SolverOptions::pipeline"};
+                        }
+
+                        ctx_t& c = *arena[next];
+                        c.reset(hex_header_hash, hex_header_hash_len, proofSize);
+                        trimming = c.trimmer->trim_async();
+
+                        bool found = false;
+                        _cancelled = false;
+                        if (pending) {
+                            found = finish(*arena[next ^ 1], cycles);
+                        }
+
+                        for (auto& j : trimming) {
+                            j.wait();
+                        }
+                        trimming.clear();
+                        planned(c);
+
+                        pending = true;
+                        next ^= 1;
+                        return found;
+                    }
+
+                    bool flush(Cycles& cycles) override
+                    {
+                        if (!pending) {
+                            return false;
+                        }
+
+                        pending = false;
+                        return finish(*arena[next ^ 1], cycles);
+                    }
+
+                private:
+                    void planned(const ctx_t& c)
+                    {
+                        if (c.trimmer->aborted) {
+                            return;
+                        }
+                        _stats.trim_rounds = c.trimmer->finalround + 2;
+                        _stats.compress_round = c.trimmer->compressround;
+                        _stats.streamed_bytes = c.trimmer->streamed();
+                        _stats.round_seconds.assign(c.trimmer->round_seconds.begin(), c.trimmer->round_seconds.begin() + _stats.trim_rounds);
+                    }
+
+                    bool finish(ctx_t& prev, Cycles& cycles)
+                    {
+                        if (prev.trimmer->overflowed) {
+                            return relax(prev, cycles);
+                        }
+                        _cancelled = prev.trimmer->aborted;
+                        if (_cancelled) {
+                            return false;
+                        }
+                        return collect(prev, prev.search(), cycles);
+                    }
+
+                    // solve a graph that overflowed a bucket again with the lean
+                    // engine, which has no buckets to overflow. it is made the
+                    // first time it is needed and kept from then on.
+                    bool relax(const ctx_t& c, Cycles& cycles)
+                    {
+                        _cancelled = c.trimmer->epoch && c.trimmer->epoch->load() != c.trimmer->start_epoch;
+                        if (_cancelled) {
+                            return false;
+                        }
+
+                        if (!lean) {
+                            // it only ever solves one graph at a time
+                            SolverOptions single = options;
+                            single.pipeline = false;
+                            lean = make_lean_solver(EDGEBITS, threads, pool, single);
+                        }
+                        _stats.overflows++;
+                        const bool found = lean->solve(c.headerhash.data(), c.headerhash.size(), c.proofSize, cycles);
+                        _cancelled = lean->cancelled();
+                        return found;
+                    }
+
+                    bool collect(const ctx_t& c, bool found, Cycles& cycles)
+                    {
+                        if (found) {
+                            for(int i = 0; i < c.sols.size() / c.proofSize; i++) {
+                                cycles.emplace_back(
+                                        c.sols.begin() + (i * c.proofSize),
+                                        c.sols.begin() + (i * c.proofSize) + c.proofSize);
+                            }
+                        }
+
+                        return found;
+                    }
+
+                private:
+                    ctx_t ctx;
+                    std::unique_ptr<ctx_t> ctx2;
+                    ctx_t* arena[2];
+                    std::uint32_t next = 0; // arena the next graph is trimmed in
+                    bool pending = false; // arena next ^ 1 holds a trimmed graph
+                    std::vector<std::future<void>> trimming;
+                    size_t threads;
+                    ctpl::thread_pool& pool;
+                    SolverOptions options;
+                    std::unique_ptr<Solver::Impl> lean; // solves the graphs that overflowed
+            };
+
+        // the configurations compiled in. every edgebits has a default XBITS,
+        // taken for xbits < 0, and from 24 on one with twice as many buckets
+        // per row for hosts whose caches favour smaller Z buckets, and one
+        // that keeps the matrix but splits each row into twice as many Y
+        // buckets for hosts with a small L2.
+        template <typename offset_t, std::uint8_t EDGEBITS, std::uint8_t XBITS, std::uint8_t YBITS>
+            struct Config
+            {
+                using solver = mean_solver<offset_t, EDGEBITS, XBITS, YBITS>;
+                const static int xbits = XBITS;
+                const static int ybits = YBITS;
+            };
+
+        // whether xbits and ybits ask for the config X, Y. xbits < 0 takes
+        // the default XBITS, ybits < 0 a YBITS equal to XBITS.
+        constexpr bool picks(int xbits, int ybits, int X, int Y, bool defaultx)
+        {
+            return (xbits == X || (xbits < 0 && defaultx)) && (ybits == Y || (ybits < 0 && Y == X));
+        }
+
+        template <typename F>
+            auto with_config(std::uint8_t edgeBits, int xbits, int ybits, F&& f)
+            {
+                switch (edgeBits) {
+                    case 16:
+                        if (picks(xbits, ybits, 0, 0, true)) return f(Config<std::uint32_t, 16u, 0u, 0u>{});
+                        break;
+                    case 17:
+                        if (picks(xbits, ybits, 1, 1, true)) return f(Config<std::uint32_t, 17u, 1u, 1u>{});
+                        break;
+                    case 18:
+                        if (picks(xbits, ybits, 1, 1, true)) return f(Config<std::uint32_t, 18u, 1u, 1u>{});
+                        break;
+                    case 19:
+                        if (picks(xbits, ybits, 2, 2, true)) return f(Config<std::uint32_t, 19u, 2u, 2u>{});
+                        break;
+                    case 20:
+                        if (picks(xbits, ybits, 2, 2, true)) return f(Config<std::uint32_t, 20u, 2u, 2u>{});
+                        break;
+                    case 21:
+                        if (picks(xbits, ybits, 3, 3, true)) return f(Config<std::uint32_t, 21u, 3u, 3u>{});
+                        break;
+                    case 22:
+                        if (picks(xbits, ybits, 3, 3, true)) return f(Config<std::uint32_t, 22u, 3u, 3u>{});
+                        break;
+                    case 23:
+                        if (picks(xbits, ybits, 4, 4, true)) return f(Config<std::uint32_t, 23u, 4u, 4u>{});
+                        break;
+                    case 24:
+                        if (picks(xbits, ybits, 4, 4, true)) return f(Config<std::uint32_t, 24u, 4u, 4u>{});
+                        if (picks(xbits, ybits, 4, 5, true)) return f(Config<std::uint32_t, 24u, 4u, 5u>{});
+                        if (picks(xbits, ybits, 5, 5, false)) return f(Config<std::uint32_t, 24u, 5u, 5u>{});
+                        break;
+                    case 25:
+                        if (picks(xbits, ybits, 5, 5, true)) return f(Config<std::uint32_t, 25u, 5u, 5u>{});
+                        if (picks(xbits, ybits, 5, 6, true)) return f(Config<std::uint32_t, 25u, 5u, 6u>{});
+                        if (picks(xbits, ybits, 6, 6, false)) return f(Config<std::uint32_t, 25u, 6u, 6u>{});
+                        break;
+                    case 26:
+                        if (picks(xbits, ybits, 5, 5, true)) return f(Config<std::uint32_t, 26u, 5u, 5u>{});
+                        if (picks(xbits, ybits, 5, 6, true)) return f(Config<std::uint32_t, 26u, 5u, 6u>{});
+                        if (picks(xbits, ybits, 6, 6, false)) return f(Config<std::uint32_t, 26u, 6u, 6u>{});
+                        break;
+                    case 27:
+                        if (picks(xbits, ybits, 6, 6, true)) return f(Config<std::uint32_t, 27u, 6u, 6u>{});
+                        if (picks(xbits, ybits, 6, 7, true)) return f(Config<std::uint32_t, 27u, 6u, 7u>{});
+                        if (picks(xbits, ybits, 7, 7, false)) return f(Config<std::uint32_t, 27u, 7u, 7u>{});
+                        break;
+                    case 28:
+                        if (picks(xbits, ybits, 6, 6, true)) return f(Config<std::uint32_t, 28u, 6u, 6u>{});
+                        if (picks(xbits, ybits, 6, 7, true)) return f(Config<std::uint32_t, 28u, 6u, 7u>{});
+                        if (picks(xbits, ybits, 7, 7, false)) return f(Config<std::uint32_t, 28u, 7u, 7u>{});
+                        break;
+                    case 29:
+                        if (picks(xbits, ybits, 7, 7, true)) return f(Config<std::uint32_t, 29u, 7u, 7u>{});
+                        if (picks(xbits, ybits, 7, 8, true)) return f(Config<std::uint32_t, 29u, 7u, 8u>{});
+                        if (picks(xbits, ybits, 8, 8, false)) return f(Config<std::uint32_t, 29u, 8u, 8u>{});
+                        break;
+                    case 30:
+                        if (picks(xbits, ybits, 8, 8, true)) return f(Config<std::uint64_t, 30u, 8u, 8u>{});
+                        if (picks(xbits, ybits, 8, 9, true)) return f(Config<std::uint64_t, 30u, 8u, 9u>{});
+                        if (picks(xbits, ybits, 9, 9, false)) return f(Config<std::uint64_t, 30u, 9u, 9u>{});
+                        break;
+                    case 31:
+                        if (picks(xbits, ybits, 8, 8, true)) return f(Config<std::uint64_t, 31u, 8u, 8u>{});
+                        if (picks(xbits, ybits, 8, 9, true)) return f(Config<std::uint64_t, 31u, 8u, 9u>{});
+                        if (picks(xbits, ybits, 9, 9, false)) return f(Config<std::uint64_t, 31u, 9u, 9u>{});
+                        break;
                 }
 
-                return found;
+                std::stringstream s;
+                s << __func__ << ": EDGEBITS equal to " << static_cast<int>(edgeBits);
+                if (xbits >= 0)
+                    s << " with XBITS equal to " << xbits;
+                if (ybits >= 0)
+                    s << (xbits >= 0 ? " and" : " with") << " YBITS equal to " << ybits;
+                s << " is not supported";
+                throw std::runtime_error{s.str()};
             }
 
-        bool FindCycles(
-                const char* hex_header_hash,
-                uint32_t hex_header_hash_len,
+        std::unique_ptr<Solver::Impl> make_solver(
+                std::uint8_t edgeBits,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                const SolverOptions& options)
+        {
+            return with_config(edgeBits, options.xbits, options.ybits, [&](auto c) -> std::unique_ptr<Solver::Impl> {
+                    return std::make_unique<typename decltype(c)::solver>(threads, pool, options);
+                    });
+        }
+
+        std::uint64_t solver_bytes(
                 std::uint8_t edgeBits,
-                std::uint8_t proofSize,
-                Cycles& cycles,
                 size_t threads,
-                ctpl::thread_pool& pool)
+                const SolverOptions& options)
+        {
+            return with_config(edgeBits, options.xbits, options.ybits, [&](auto c) {
+                    return decltype(c)::solver::bytes(threads, options);
+                    });
+        }
+
+        std::uint64_t counter_bytes(std::uint8_t edgeBits, int xbits, int ybits)
+        {
+            return with_config(edgeBits, xbits, ybits, [](auto c) {
+                    return decltype(c)::solver::ctx_t::counterbytes();
+                    });
+        }
+
+        std::vector<BucketSplit> splits_for(std::uint8_t edgeBits)
+        {
+            auto split = [](auto c) { return BucketSplit{decltype(c)::xbits, decltype(c)::ybits}; };
+            std::vector<BucketSplit> res{with_config(edgeBits, -1, -1, split)};
+            for (int x = 0; x <= MAX_EDGE_BITS / 2; x++) {
+                for (int y = x; x + y <= MAX_EDGE_BITS; y++) {
+                    try {
+                        const auto found = with_config(edgeBits, x, y, split);
+                        if (found.xbits == x && found.ybits == y && (x != res.front().xbits || y != res.front().ybits))
+                            res.push_back(found);
+                    } catch (const std::runtime_error&) {
+                    }
+                }
+            }
+            return res;
+        }
+
+        void edge_nodes(
+                const crypto::siphash_keys* const* keys,
+                const std::uint32_t* edgemasks,
+                const std::uint32_t* nonces,
+                std::uint32_t n,
+                std::uint32_t* us,
+                std::uint32_t* vs)
         {
-            switch (edgeBits) {
-                case 16: return run<std::uint32_t, 16u, 0u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 17: return run<std::uint32_t, 17u, 1u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 18: return run<std::uint32_t, 18u, 1u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 19: return run<std::uint32_t, 19u, 2u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 20: return run<std::uint32_t, 20u, 2u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 21: return run<std::uint32_t, 21u, 3u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 22: return run<std::uint32_t, 22u, 3u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 23: return run<std::uint32_t, 23u, 4u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 24: return run<std::uint32_t, 24u, 4u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 25: return run<std::uint32_t, 25u, 5u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 26: return run<std::uint32_t, 26u, 5u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 27: return run<std::uint32_t, 27u, 6u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 28: return run<std::uint32_t, 28u, 6u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 29: return run<std::uint32_t, 29u, 7u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 30: return run<std::uint64_t, 30u, 8u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-                case 31: return run<std::uint64_t, 31u, 8u>(hex_header_hash, hex_header_hash_len, proofSize, cycles, threads, pool);
-
-                default:
-                         std::stringstream s;
-                         s << __func__ << ": EDGEBITS equal to " << edgeBits << " is not supported";
-                         throw std::runtime_error{s.str()};
+            std::uint32_t i = 0;
+            // the u packets of a run of edges go in the first set of lanes
+            // and their v packets in the second. each lane takes the keys of
+            // its own edge, which need not share a header with its neighbours
+#if NSIPHASH == 8
+            const __m256i vone = _mm256_set1_epi64x(1);
+            const __m256i vff = _mm256_set1_epi64x(0xff);
+            __m256i v0, v1, v2, v3, v4, v5, v6, v7;
+            __m256i vk0, vk1, vnodemask, vpacket0, vpacket1;
+            alignas(32) std::uint64_t nodes[NSIPHASH];
+            for (; i + NSIPHASH / 2 <= n; i += NSIPHASH / 2) {
+                vk0 = _mm256_set_epi64x(keys[i + 3]->k0, keys[i + 2]->k0, keys[i + 1]->k0, keys[i]->k0);
+                vk1 = _mm256_set_epi64x(keys[i + 3]->k1, keys[i + 2]->k1, keys[i + 1]->k1, keys[i]->k1);
+                vnodemask = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(edgemasks + i)));
+                vpacket0 = _mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(nonces + i))), 1);
+                vpacket1 = _mm256_or_si256(vpacket0, vone);
+
+                v0 = v4 = XOR(vk0, _mm256_set1_epi64x(0x736f6d6570736575ULL));
+                v1 = v5 = XOR(vk1, _mm256_set1_epi64x(0x646f72616e646f6dULL));
+                v2 = v6 = XOR(vk0, _mm256_set1_epi64x(0x6c7967656e657261ULL));
+                v3 = v7 = XOR(vk1, _mm256_set1_epi64x(0x7465646279746573ULL));
+
+                v3 = XOR(v3, vpacket0);
+                v7 = XOR(v7, vpacket1);
+                SIPROUNDX8;
+                SIPROUNDX8;
+                v0 = XOR(v0, vpacket0);
+                v4 = XOR(v4, vpacket1);
+                v2 = XOR(v2, vff);
+                v6 = XOR(v6, vff);
+                SIPROUNDX8;
+                SIPROUNDX8;
+                SIPROUNDX8;
+                SIPROUNDX8;
+                v0 = XOR(XOR(v0, v1), XOR(v2, v3));
+                v4 = XOR(XOR(v4, v5), XOR(v6, v7));
+
+                _mm256_store_si256((__m256i*)nodes, v0 & vnodemask);
+                _mm256_store_si256((__m256i*)(nodes + NSIPHASH / 2), v4 & vnodemask);
+                for (std::uint32_t j = 0; j < NSIPHASH / 2; j++) {
+                    us[i + j] = nodes[j];
+                    vs[i + j] = nodes[NSIPHASH / 2 + j];
+                }
+            }
+#elif NSIPHASH == 16
+            const __m512i vff = _mm512_set1_epi64(0xff);
+            const __m512i vone = _mm512_set1_epi64(1);
+            __m512i v0, v1, v2, v3, v4, v5, v6, v7;
+            __m512i vk0, vk1, vnodemask, vpacket0, vpacket1;
+            for (; i + NSIPHASH / 2 <= n; i += NSIPHASH / 2) {
+                vk0 = _mm512_set_epi64(
+                        keys[i + 7]->k0, keys[i + 6]->k0, keys[i + 5]->k0, keys[i + 4]->k0,
+                        keys[i + 3]->k0, keys[i + 2]->k0, keys[i + 1]->k0, keys[i]->k0);
+                vk1 = _mm512_set_epi64(
+                        keys[i + 7]->k1, keys[i + 6]->k1, keys[i + 5]->k1, keys[i + 4]->k1,
+                        keys[i + 3]->k1, keys[i + 2]->k1, keys[i + 1]->k1, keys[i]->k1);
+                vnodemask = _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)(edgemasks + i)));
+                vpacket0 = _mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)(nonces + i))), 1);
+                vpacket1 = _mm512_or_si512(vpacket0, vone);
+
+                v0 = v4 = XORX16(vk0, _mm512_set1_epi64(0x736f6d6570736575ULL));
+                v1 = v5 = XORX16(vk1, _mm512_set1_epi64(0x646f72616e646f6dULL));
+                v2 = v6 = XORX16(vk0, _mm512_set1_epi64(0x6c7967656e657261ULL));
+                v3 = v7 = XORX16(vk1, _mm512_set1_epi64(0x7465646279746573ULL));
+
+                v3 = XORX16(v3, vpacket0);
+                v7 = XORX16(v7, vpacket1);
+                SIPROUNDX16;
+                SIPROUNDX16;
+                v0 = XORX16(v0, vpacket0);
+                v4 = XORX16(v4, vpacket1);
+                v2 = XORX16(v2, vff);
+                v6 = XORX16(v6, vff);
+                SIPROUNDX16;
+                SIPROUNDX16;
+                SIPROUNDX16;
+                SIPROUNDX16;
+                v0 = XORX16(XORX16(v0, v1), XORX16(v2, v3));
+                v4 = XORX16(XORX16(v4, v5), XORX16(v6, v7));
+
+                _mm256_storeu_si256((__m256i*)(us + i), _mm512_cvtepi64_epi32(_mm512_and_si512(v0, vnodemask)));
+                _mm256_storeu_si256((__m256i*)(vs + i), _mm512_cvtepi64_epi32(_mm512_and_si512(v4, vnodemask)));
             }
+#elif NSIPHASH == 4
+            const __m128i vff = _mm_set1_epi64x(0xff);
+            const __m128i vone = _mm_set1_epi64x(1);
+            __m128i v0, v1, v2, v3, v4, v5, v6, v7;
+            __m128i vk0, vk1, vnodemask, vpacket0, vpacket1;
+            alignas(16) std::uint64_t nodes[NSIPHASH];
+            for (; i + NSIPHASH / 2 <= n; i += NSIPHASH / 2) {
+                vk0 = _mm_set_epi64x(keys[i + 1]->k0, keys[i]->k0);
+                vk1 = _mm_set_epi64x(keys[i + 1]->k1, keys[i]->k1);
+                vnodemask = _mm_cvtepu32_epi64(_mm_loadl_epi64((const __m128i*)(edgemasks + i)));
+                vpacket0 = _mm_slli_epi64(_mm_cvtepu32_epi64(_mm_loadl_epi64((const __m128i*)(nonces + i))), 1);
+                vpacket1 = _mm_or_si128(vpacket0, vone);
+
+                v0 = v4 = XORX4(vk0, _mm_set1_epi64x(0x736f6d6570736575ULL));
+                v1 = v5 = XORX4(vk1, _mm_set1_epi64x(0x646f72616e646f6dULL));
+                v2 = v6 = XORX4(vk0, _mm_set1_epi64x(0x6c7967656e657261ULL));
+                v3 = v7 = XORX4(vk1, _mm_set1_epi64x(0x7465646279746573ULL));
+
+                v3 = XORX4(v3, vpacket0);
+                v7 = XORX4(v7, vpacket1);
+                SIPROUNDX4;
+                SIPROUNDX4;
+                v0 = XORX4(v0, vpacket0);
+                v4 = XORX4(v4, vpacket1);
+                v2 = XORX4(v2, vff);
+                v6 = XORX4(v6, vff);
+                SIPROUNDX4;
+                SIPROUNDX4;
+                SIPROUNDX4;
+                SIPROUNDX4;
+                v0 = XORX4(XORX4(v0, v1), XORX4(v2, v3));
+                v4 = XORX4(XORX4(v4, v5), XORX4(v6, v7));
+
+                _mm_store_si128((__m128i*)nodes, _mm_and_si128(v0, vnodemask));
+                _mm_store_si128((__m128i*)(nodes + NSIPHASH / 2), _mm_and_si128(v4, vnodemask));
+                for (std::uint32_t j = 0; j < NSIPHASH / 2; j++) {
+                    us[i + j] = nodes[j];
+                    vs[i + j] = nodes[NSIPHASH / 2 + j];
+                }
+            }
+#endif
+            for (; i < n; i++) {
+                us[i] = _sipnode(keys[i], edgemasks[i], nonces[i], 0);
+                vs[i] = _sipnode(keys[i], edgemasks[i], nonces[i], 1);
+            }
+        }
+
+        Isa compiled_isa()
+        {
+            return COMPILED_ISA;
         }
+        } // namespace BITCASH_CUCKOO_ISA
     } //namespace cuckoo
 } //namespace bitcash
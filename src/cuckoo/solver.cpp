@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#include "solver_impl.h"
+#include "bitcash/cuckoo/tuning.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        namespace
+        {
+            struct Variant
+            {
+                Isa isa;
+                SolverFactory make;
+                EdgeNodes nodes;
+            };
+
+            // best first
+            std::vector<Variant> variants()
+            {
+                std::vector<Variant> v;
+#ifdef BITCASH_CUCKOO_DISPATCH
+                v.push_back({avx512::compiled_isa(), avx512::make_solver, avx512::edge_nodes});
+                v.push_back({avx2::compiled_isa(), avx2::make_solver, avx2::edge_nodes});
+                v.push_back({sse41::compiled_isa(), sse41::make_solver, sse41::edge_nodes});
+#endif
+                v.push_back({generic::compiled_isa(), generic::make_solver, generic::edge_nodes});
+                return v;
+            }
+
+            bool cpu_supports(Isa isa)
+            {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+                switch(isa) {
+                    case Isa::AVX512:
+                        return __builtin_cpu_supports("avx512f")
+                            && __builtin_cpu_supports("avx512vl")
+                            && __builtin_cpu_supports("avx512bw")
+                            && __builtin_cpu_supports("avx512dq");
+                    case Isa::AVX2: return __builtin_cpu_supports("avx2");
+                    case Isa::SSE41: return __builtin_cpu_supports("sse4.1");
+                    default: return true;
+                }
+#else
+                return true;
+#endif
+            }
+
+            // the tuned profile fills in a split the caller left open,
+            // as long as it is compiled in, and a prefetch distance
+            SolverOptions resolve(std::uint8_t edgeBits, size_t threads, const SolverOptions& options)
+            {
+                SolverOptions resolved = options;
+                if(resolved.engine != Engine::Mean) {
+                    return resolved;
+                }
+
+                if(resolved.prefetch_distance < 0) {
+                    resolved.prefetch_distance = ProfilePrefetch(edgeBits, threads);
+                }
+
+                if(resolved.xbits >= 0 || resolved.ybits >= 0) {
+                    return resolved;
+                }
+
+                const auto split = ProfileSplit(edgeBits, threads);
+                const auto available = AvailableSplits(edgeBits);
+                const bool compiled = std::any_of(available.begin(), available.end(), [&split](const BucketSplit& s) {
+                        return s.xbits == split.xbits && s.ybits == split.ybits;
+                        });
+                if(split.xbits >= 0 && compiled) {
+                    resolved.xbits = split.xbits;
+                    resolved.ybits = split.ybits;
+                }
+                return resolved;
+            }
+
+            Variant variant(Isa isa)
+            {
+                if(isa == Isa::Auto) {
+                    isa = BestIsa();
+                }
+
+                if(!cpu_supports(isa)) {
+                    std::stringstream s;
+                    s << "the cpu does not support the " << to_string(isa) << " solver";
+                    throw std::runtime_error{s.str()};
+                }
+
+                for(const auto& v : variants()) {
+                    if(v.isa == isa) {
+                        return v;
+                    }
+                }
+
+                std::stringstream s;
+                s << "the " << to_string(isa) << " solver is not compiled in";
+                throw std::runtime_error{s.str()};
+            }
+        }
+
+        EdgeNodes edge_nodes_for(Isa isa)
+        {
+            return variant(isa).nodes;
+        }
+
+        const char* to_string(Isa isa)
+        {
+            switch(isa) {
+                case Isa::Scalar: return "scalar";
+                case Isa::SSE41: return "sse4.1";
+                case Isa::AVX2: return "avx2";
+                case Isa::AVX512: return "avx512";
+                default: return "auto";
+            }
+        }
+
+        const char* to_string(Engine engine)
+        {
+            switch(engine) {
+                case Engine::Lean: return "lean";
+                default: return "mean";
+            }
+        }
+
+        Engine ParseEngine(const std::string& name)
+        {
+            for(auto engine : {Engine::Mean, Engine::Lean}) {
+                if(name == to_string(engine)) {
+                    return engine;
+                }
+            }
+
+            std::stringstream s;
+            s << "unknown solver engine " << name;
+            throw std::runtime_error{s.str()};
+        }
+
+        Isa BestIsa()
+        {
+            static const Isa best = []() {
+                for(const auto& v : variants()) {
+                    if(cpu_supports(v.isa)) {
+                        return v.isa;
+                    }
+                }
+                return generic::compiled_isa();
+            }();
+            return best;
+        }
+
+        std::vector<Isa> AvailableIsas()
+        {
+            std::vector<Isa> res;
+            for(const auto& v : variants()) {
+                if(cpu_supports(v.isa)) {
+                    res.push_back(v.isa);
+                }
+            }
+            return res;
+        }
+
+        Solver::Solver(
+                std::uint8_t edgeBits,
+                size_t threads_number,
+                ctpl::thread_pool& pool,
+                const SolverOptions& options) :
+            _edgebits{edgeBits},
+            _threads{threads_number},
+            _impl{options.engine == Engine::Lean ?
+                make_lean_solver(edgeBits, threads_number, pool, options) :
+                variant(options.isa).make(edgeBits, threads_number, pool, resolve(edgeBits, threads_number, options))}
+        {
+        }
+
+        Solver::~Solver() = default;
+
+        bool Solver::solve(
+                const char* hex_header_hash,
+                uint32_t hex_header_hash_len,
+                std::uint8_t proofSize,
+                Cycles& cycles)
+        {
+            return _impl->solve(hex_header_hash, hex_header_hash_len, proofSize, cycles);
+        }
+
+        bool Solver::solve_next(
+                const char* hex_header_hash,
+                uint32_t hex_header_hash_len,
+                std::uint8_t proofSize,
+                Cycles& cycles)
+        {
+            return _impl->solve_next(hex_header_hash, hex_header_hash_len, proofSize, cycles);
+        }
+
+        bool Solver::flush(Cycles& cycles)
+        {
+            return _impl->flush(cycles);
+        }
+
+        bool Solver::cancelled() const
+        {
+            return _impl->cancelled();
+        }
+
+        const SolverStats& Solver::stats() const
+        {
+            return _impl->stats();
+        }
+
+        std::uint8_t Solver::edgebits() const
+        {
+            return _edgebits;
+        }
+
+        size_t Solver::threads() const
+        {
+            return _threads;
+        }
+
+        uint64_t SolverBytes(
+                std::uint8_t edgeBits,
+                size_t threads_number,
+                const SolverOptions& options)
+        {
+            if(options.engine == Engine::Lean) {
+                return lean_solver_bytes(edgeBits);
+            }
+            // the layout does not depend on the instruction set
+            return generic::solver_bytes(edgeBits, threads_number, resolve(edgeBits, threads_number, options));
+        }
+
+        std::vector<BucketSplit> AvailableSplits(std::uint8_t edgeBits)
+        {
+            return generic::splits_for(edgeBits);
+        }
+
+        bool FindCycles(
+                const char* hex_header_hash,
+                uint32_t hex_header_hash_len,
+                std::uint8_t edgeBits,
+                std::uint8_t proofSize,
+                Cycles& cycles,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                const Epoch* epoch,
+                Engine engine)
+        {
+            SolverOptions options;
+            options.epoch = epoch;
+            options.engine = engine;
+            Solver solver{edgeBits, threads, pool, options};
+            return solver.solve(hex_header_hash, hex_header_hash_len, proofSize, cycles);
+        }
+    } //namespace cuckoo
+} //namespace bitcash
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#ifndef BITCASH_CUCKOO_SOLVER_IMPL_H
+#define BITCASH_CUCKOO_SOLVER_IMPL_H
+
+#include "bitcash/cuckoo/mean_cuckoo.h"
+#include "bitcash/crypto/siphash.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        // type erased holder of a solver_ctx so the buffers survive between graphs
+        class Solver::Impl
+        {
+            public:
+                virtual ~Impl() {}
+                virtual bool solve(
+                        const char* hex_header_hash,
+                        uint32_t hex_header_hash_len,
+                        std::uint8_t proofSize,
+                        Cycles& cycles) = 0;
+                virtual bool solve_next(
+                        const char* hex_header_hash,
+                        uint32_t hex_header_hash_len,
+                        std::uint8_t proofSize,
+                        Cycles& cycles) = 0;
+                virtual bool flush(Cycles& cycles) = 0;
+
+                const SolverStats& stats() const { return _stats; }
+                bool cancelled() const { return _cancelled; }
+
+            protected:
+                SolverStats _stats;
+                bool _cancelled = false;
+        };
+
+        using SolverFactory = std::unique_ptr<Solver::Impl> (*)(
+                std::uint8_t edgeBits,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                const SolverOptions& options);
+
+        // u and v endpoints of n edges, without the partition bit. edge i
+        // is hashed with *keys[i] and masked with edgemasks[i], so the edges
+        // of many proofs share the lanes
+        using EdgeNodes = void (*)(
+                const crypto::siphash_keys* const* keys,
+                const std::uint32_t* edgemasks,
+                const std::uint32_t* nonces,
+                std::uint32_t n,
+                std::uint32_t* us,
+                std::uint32_t* vs);
+
+        // solver.cpp, hashing of the variant the cpu supports, Auto for the best
+        EdgeNodes edge_nodes_for(Isa isa);
+
+        // lean_cuckoo.cpp, compiled once
+        std::unique_ptr<Solver::Impl> make_lean_solver(
+                std::uint8_t edgeBits,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                const SolverOptions& options);
+        std::uint64_t lean_solver_bytes(std::uint8_t edgeBits);
+
+        // mean_cuckoo.cpp compiled for one instruction set
+#define BITCASH_CUCKOO_DECLARE_ISA(isa)                         \
+        namespace isa                                           \
+        {                                                       \
+            Isa compiled_isa();                                 \
+            std::unique_ptr<Solver::Impl> make_solver(          \
+                    std::uint8_t edgeBits,                      \
+                    size_t threads,                             \
+                    ctpl::thread_pool& pool,                    \
+                    const SolverOptions& options);              \
+            std::uint64_t solver_bytes(                         \
+                    std::uint8_t edgeBits,                      \
+                    size_t threads,                             \
+                    const SolverOptions& options);              \
+            std::vector<BucketSplit> splits_for(                \
+                    std::uint8_t edgeBits);                     \
+            std::uint64_t counter_bytes(                        \
+                    std::uint8_t edgeBits,                      \
+                    int xbits,                                  \
+                    int ybits);                                 \
+            void edge_nodes(                                    \
+                    const crypto::siphash_keys* const* keys,    \
+                    const std::uint32_t* edgemasks,             \
+                    const std::uint32_t* nonces,                \
+                    std::uint32_t n,                            \
+                    std::uint32_t* us,                          \
+                    std::uint32_t* vs);                         \
+        }
+
+        BITCASH_CUCKOO_DECLARE_ISA(generic)
+#ifdef BITCASH_CUCKOO_DISPATCH
+        BITCASH_CUCKOO_DECLARE_ISA(sse41)
+        BITCASH_CUCKOO_DECLARE_ISA(avx2)
+        BITCASH_CUCKOO_DECLARE_ISA(avx512)
+#endif
+    }
+}
+
+#endif // BITCASH_CUCKOO_SOLVER_IMPL_H
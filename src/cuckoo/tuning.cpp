@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#include "bitcash/cuckoo/tuning.h"
+#include "solver_impl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        namespace
+        {
+            const char* CACHE_PATH = "/sys/devices/system/cpu/cpu0/cache";
+
+            struct ProfileEntry
+            {
+                BucketSplit split{-1, -1};
+                int prefetch = -1;
+            };
+
+            // (edgebits, threads) -> what was tuned for them
+            using Profile = std::map<std::pair<int, int>, ProfileEntry>;
+
+            const int PREFETCH_CANDIDATES[] = {0, 4, 8, 16, 32, 64};
+
+            std::mutex profile_mutex;
+
+            bool read_line(const std::string& path, std::string& line)
+            {
+                std::ifstream f{path};
+                return f && std::getline(f, line);
+            }
+
+            // sysfs sizes read like "2048K"
+            uint64_t parse_size(const std::string& size)
+            {
+                std::stringstream s{size};
+                uint64_t n = 0;
+                char unit = 0;
+                s >> n >> unit;
+                switch(unit) {
+                    case 'K': return n << 10;
+                    case 'M': return n << 20;
+                    case 'G': return n << 30;
+                    default: return n;
+                }
+            }
+
+            Profile read_profile(const std::string& path)
+            {
+                Profile profile;
+                std::ifstream f{path};
+                std::string line;
+                while(std::getline(f, line)) {
+                    if(line.empty() || line[0] == '#') {
+                        continue;
+                    }
+                    std::stringstream s{line};
+                    int edgebits, threads, xbits, ybits, prefetch = -1;
+                    if(s >> edgebits >> threads >> xbits) {
+                        // profiles from before the split have no ybits column,
+                        // from before prefetch tuning no prefetch one
+                        if(!(s >> ybits)) {
+                            ybits = xbits;
+                        } else {
+                            s >> prefetch;
+                        }
+                        profile[{edgebits, threads}] = ProfileEntry{BucketSplit{xbits, ybits}, prefetch};
+                    }
+                }
+                return profile;
+            }
+
+            // read on first use, updated by SaveProfileSplit
+            Profile& loaded_profile()
+            {
+                static Profile profile = read_profile(XbitsProfilePath());
+                return profile;
+            }
+
+            void make_dir(const std::string& dir)
+            {
+#ifdef _WIN32
+                _mkdir(dir.c_str());
+#else
+                mkdir(dir.c_str(), 0755);
+#endif
+            }
+
+            // the entry for edgebits with the closest thread count that
+            // has what used says it has, null without one
+            template <typename Used>
+            const ProfileEntry* closest(uint8_t edgeBits, size_t threads, Used used)
+            {
+                const ProfileEntry* best = nullptr;
+                int distance = 0;
+                for(const auto& entry : loaded_profile()) {
+                    if(entry.first.first != edgeBits || !used(entry.second)) {
+                        continue;
+                    }
+                    const int d = std::abs(entry.first.second - static_cast<int>(threads));
+                    if(!best || d < distance) {
+                        best = &entry.second;
+                        distance = d;
+                    }
+                }
+                return best;
+            }
+
+            // applies update to the entry of edgebits and threads and
+            // writes the profile back
+            template <typename Update>
+            void save_profile(uint8_t edgeBits, size_t threads, Update update)
+            {
+                std::lock_guard<std::mutex> guard{profile_mutex};
+                const auto path = XbitsProfilePath();
+                auto profile = read_profile(path);
+                update(profile[{edgeBits, static_cast<int>(threads)}]);
+
+                const auto slash = path.find_last_of('/');
+                if(slash != std::string::npos) {
+                    make_dir(path.substr(0, slash));
+                }
+
+                std::ofstream f{path};
+                if(!f) {
+                    throw std::runtime_error{"could not write the xbits profile " + path};
+                }
+
+                const auto caches = ReadCacheSizes();
+                f << "# edgebits threads xbits ybits prefetch, written by bitcash-bench --tune, -1 when not tuned" << std::endl;
+                f << "# l2 " << caches.l2 << " l3 " << caches.l3 << std::endl;
+                for(const auto& entry : profile) {
+                    f << entry.first.first << " " << entry.first.second
+                        << " " << entry.second.split.xbits << " " << entry.second.split.ybits
+                        << " " << entry.second.prefetch << std::endl;
+                }
+
+                loaded_profile() = profile;
+            }
+
+            // seconds solver takes a graph, averaged over graphs of them. the
+            // first graph faults in the matrix and is not timed.
+            double time_graphs(Solver& solver, int graphs)
+            {
+                auto solve = [&solver](int i) {
+                    char header[65];
+                    std::snprintf(header, sizeof(header), "%064x", i);
+                    Cycles cycles;
+                    solver.solve(header, 64, 42, cycles);
+                };
+
+                solve(graphs);
+                const auto start = std::chrono::steady_clock::now();
+                for(int i = 0; i < graphs; i++) {
+                    solve(i);
+                }
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / std::max(graphs, 1);
+            }
+        }
+
+        CacheSizes ReadCacheSizes()
+        {
+            CacheSizes sizes;
+            for(int i = 0; ; i++) {
+                const auto dir = std::string{CACHE_PATH} + "/index" + std::to_string(i);
+                std::string level, type, size;
+                if(!read_line(dir + "/level", level)) {
+                    break;
+                }
+                if(!read_line(dir + "/type", type) || type == "Instruction" || !read_line(dir + "/size", size)) {
+                    continue;
+                }
+
+                if(level == "2") {
+                    sizes.l2 = parse_size(size);
+                } else if(level == "3") {
+                    sizes.l3 = parse_size(size);
+                }
+            }
+            return sizes;
+        }
+
+        std::string XbitsProfilePath()
+        {
+            if(const char* path = std::getenv("BITCASH_XBITS_PROFILE")) {
+                return path;
+            }
+
+            const char* home = std::getenv("HOME");
+            if(!home) {
+                home = std::getenv("USERPROFILE");
+            }
+            return std::string{home ? home : "."} + "/.bitcash/xbits.profile";
+        }
+
+        BucketSplit ProfileSplit(uint8_t edgeBits, size_t threads)
+        {
+            std::lock_guard<std::mutex> guard{profile_mutex};
+            const auto entry = closest(edgeBits, threads, [](const ProfileEntry& e) { return e.split.xbits >= 0; });
+            return entry ? entry->split : BucketSplit{-1, -1};
+        }
+
+        void SaveProfileSplit(uint8_t edgeBits, size_t threads, BucketSplit split)
+        {
+            save_profile(edgeBits, threads, [split](ProfileEntry& e) { e.split = split; });
+        }
+
+        int ProfilePrefetch(uint8_t edgeBits, size_t threads)
+        {
+            std::lock_guard<std::mutex> guard{profile_mutex};
+            const auto entry = closest(edgeBits, threads, [](const ProfileEntry& e) { return e.prefetch >= 0; });
+            return entry ? entry->prefetch : -1;
+        }
+
+        void SaveProfilePrefetch(uint8_t edgeBits, size_t threads, int distance)
+        {
+            save_profile(edgeBits, threads, [distance](ProfileEntry& e) { e.prefetch = distance; });
+        }
+
+        std::vector<SplitTiming> TuneSplits(
+                uint8_t edgeBits,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                SolverOptions options,
+                int graphs)
+        {
+            const auto caches = ReadCacheSizes();
+
+            std::vector<SplitTiming> timings;
+            bool fits = false;
+            for(const auto& split : AvailableSplits(edgeBits)) {
+                const uint64_t counters = generic::counter_bytes(edgeBits, split.xbits, split.ybits);
+                fits |= !caches.l2 || counters <= caches.l2;
+                timings.push_back({split, counters, false, 0});
+            }
+
+            options.engine = Engine::Mean;
+            for(auto& t : timings) {
+                if(fits && caches.l2 && t.counter_bytes > caches.l2) {
+                    t.skipped = true;
+                    continue;
+                }
+
+                options.xbits = t.split.xbits;
+                options.ybits = t.split.ybits;
+                Solver solver{edgeBits, threads, pool, options};
+                t.seconds = time_graphs(solver, graphs);
+            }
+            return timings;
+        }
+
+        std::vector<PrefetchTiming> TunePrefetch(
+                uint8_t edgeBits,
+                size_t threads,
+                ctpl::thread_pool& pool,
+                SolverOptions options,
+                int graphs)
+        {
+            std::vector<PrefetchTiming> timings;
+            options.engine = Engine::Mean;
+            for(const int distance : PREFETCH_CANDIDATES) {
+                options.prefetch_distance = distance;
+                Solver solver{edgeBits, threads, pool, options};
+                const double seconds = time_graphs(solver, graphs);
+                timings.push_back({distance, seconds, solver.stats().round_seconds});
+            }
+            return timings;
+        }
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#include "bitcash/cuckoo/verify.h"
+#include "bitcash/blake2/blake2.h"
+#include "solver_impl.h"
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <stdexcept>
+
+namespace bitcash
+{
+    namespace cuckoo
+    {
+        namespace
+        {
+            // same as setHeader in mean_cuckoo.cpp
+            crypto::siphash_keys header_keys(const char* header, std::uint32_t headerlen)
+            {
+                char hdrkey[32];
+                blake2b((void *)hdrkey, sizeof(hdrkey), (const void *)header, headerlen, 0, 0);
+                crypto::siphash_keys keys;
+                crypto::setkeys(&keys, hdrkey);
+                return keys;
+            }
+
+            // what Tromp's verify can tell from the nonces alone, Ok when the
+            // proof is to be hashed. Proofs are sorted on construction so a
+            // repeated nonce sits next to its twin.
+            ProofStatus check_nonces(std::uint8_t edgeBits, std::uint8_t proofSize, const Cycle& proof)
+            {
+                if(edgeBits == 0 || edgeBits > 31) {
+                    std::stringstream s;
+                    s << "cannot verify proofs at edgebits " << static_cast<int>(edgeBits);
+                    throw std::runtime_error{s.str()};
+                }
+                if(proof.size() != proofSize || proofSize == 0) {
+                    return ProofStatus::WrongLength;
+                }
+
+                const std::uint32_t edgemask = (1U << edgeBits) - 1;
+                for(size_t i = 0; i < proof.size(); i++) {
+                    if(proof[i] > edgemask) {
+                        return ProofStatus::NonceTooBig;
+                    }
+                    if(i && proof[i] == proof[i - 1]) {
+                        return ProofStatus::DuplicateNonce;
+                    }
+                }
+                return ProofStatus::Ok;
+            }
+
+            const std::uint16_t NO_EDGE = 256;
+            const std::uint16_t MORE_EDGES = 257;
+
+            // for each edge, the one other edge of the proof at its end in
+            // ends, or NO_EDGE or MORE_EDGES. The ends go through a table
+            // at least twice the proof size, hashed on their low bits.
+            void pair_ends(const std::uint32_t* ends, size_t proofSize, std::uint16_t* other)
+            {
+                size_t slots = 4;
+                while(slots < 2 * proofSize) {
+                    slots *= 2;
+                }
+                std::array<std::uint16_t, 512> table; // first edge + 1, 0 for none
+                std::fill_n(table.begin(), slots, 0);
+
+                for(size_t i = 0; i < proofSize; i++) {
+                    other[i] = NO_EDGE;
+                    size_t h = ends[i] & (slots - 1);
+                    while(table[h] && ends[table[h] - 1] != ends[i]) {
+                        h = (h + 1) & (slots - 1);
+                    }
+                    if(!table[h]) {
+                        table[h] = i + 1;
+                        continue;
+                    }
+                    const size_t first = table[h] - 1;
+                    if(other[first] == NO_EDGE) {
+                        other[first] = i;
+                        other[i] = first;
+                        continue;
+                    }
+                    if(other[first] != MORE_EDGES) {
+                        other[other[first]] = MORE_EDGES;
+                        other[first] = MORE_EDGES;
+                    }
+                    other[i] = MORE_EDGES;
+                }
+            }
+
+            // the rest of Tromp's verify, on the hashed endpoints of a proof
+            ProofStatus check_cycle(const std::uint32_t* us, const std::uint32_t* vs, size_t proofSize)
+            {
+                std::uint32_t xor0 = 0, xor1 = 0;
+                for(size_t i = 0; i < proofSize; i++) {
+                    xor0 ^= us[i];
+                    xor1 ^= vs[i];
+                }
+                // every endpoint of a cycle is shared by exactly two edges
+                if(xor0 | xor1) {
+                    return ProofStatus::NotACycle;
+                }
+
+                // proofsize fits a uint8_t
+                std::array<std::uint16_t, 256> uother, vother;
+                pair_ends(us, proofSize, uother.data());
+                pair_ends(vs, proofSize, vother.data());
+
+                // follow the cycle from edge 0, alternating between its u and v ends
+                size_t n = 0, i = 0;
+                bool onu = true;
+                do {
+                    const std::uint16_t j = onu ? uother[i] : vother[i];
+                    if(j == MORE_EDGES) {
+                        return ProofStatus::Branch;
+                    }
+                    if(j == NO_EDGE) {
+                        return ProofStatus::NotACycle;
+                    }
+                    i = j;
+                    onu = !onu;
+                    n++;
+                } while(i != 0 || !onu);
+
+                return n == proofSize ? ProofStatus::Ok : ProofStatus::ShortCycle;
+            }
+        }
+
+        const char* to_string(ProofStatus status)
+        {
+            switch(status) {
+                case ProofStatus::Ok: return "ok";
+                case ProofStatus::WrongLength: return "wrong length";
+                case ProofStatus::NonceTooBig: return "nonce too big";
+                case ProofStatus::DuplicateNonce: return "duplicate nonce";
+                case ProofStatus::NotACycle: return "not a cycle";
+                case ProofStatus::Branch: return "branch";
+                default: return "short cycle";
+            }
+        }
+
+        ProofStatus VerifyProof(
+                const char* hex_header_hash,
+                uint32_t hex_header_hash_len,
+                uint8_t edgeBits,
+                uint8_t proofSize,
+                const Cycle& proof)
+        {
+            const auto status = check_nonces(edgeBits, proofSize, proof);
+            if(status != ProofStatus::Ok) {
+                return status;
+            }
+
+            // proofsize fits a uint8_t
+            const auto keys = header_keys(hex_header_hash, hex_header_hash_len);
+            std::array<const crypto::siphash_keys*, 256> edgekeys;
+            std::array<std::uint32_t, 256> edgemasks, us, vs;
+            edgekeys.fill(&keys);
+            edgemasks.fill((1U << edgeBits) - 1);
+            edge_nodes_for(Isa::Auto)(edgekeys.data(), edgemasks.data(), proof.data(), proofSize, us.data(), vs.data());
+            return check_cycle(us.data(), vs.data(), proofSize);
+        }
+
+        std::vector<ProofStatus> VerifyProofs(const std::vector<ProofCheck>& checks, Isa isa)
+        {
+            const auto nodes = edge_nodes_for(isa);
+
+            std::vector<ProofStatus> res;
+            res.reserve(checks.size());
+            std::vector<crypto::siphash_keys> keys;
+            keys.reserve(checks.size());
+            size_t edges = 0;
+            for(const auto& c : checks) {
+                res.push_back(check_nonces(c.edgebits, c.proofsize, c.proof));
+                keys.push_back(res.back() == ProofStatus::Ok
+                        ? header_keys(c.hex_header_hash.data(), c.hex_header_hash.size())
+                        : crypto::siphash_keys{});
+                if(res.back() == ProofStatus::Ok) {
+                    edges += c.proofsize;
+                }
+            }
+
+            // the edges of every proof left go through the lanes in one
+            // stream, so only the end of the batch rather than of every
+            // proof falls to the scalar tail
+            std::vector<const crypto::siphash_keys*> edgekeys;
+            std::vector<std::uint32_t> edgemasks, nonces;
+            edgekeys.reserve(edges);
+            edgemasks.reserve(edges);
+            nonces.reserve(edges);
+            for(size_t i = 0; i < checks.size(); i++) {
+                if(res[i] != ProofStatus::Ok) {
+                    continue;
+                }
+                edgekeys.insert(edgekeys.end(), checks[i].proofsize, &keys[i]);
+                edgemasks.insert(edgemasks.end(), checks[i].proofsize, (1U << checks[i].edgebits) - 1);
+                nonces.insert(nonces.end(), checks[i].proof.begin(), checks[i].proof.end());
+            }
+            std::vector<std::uint32_t> us(edges), vs(edges);
+            nodes(edgekeys.data(), edgemasks.data(), nonces.data(), edges, us.data(), vs.data());
+
+            size_t at = 0;
+            for(size_t i = 0; i < checks.size(); i++) {
+                if(res[i] != ProofStatus::Ok) {
+                    continue;
+                }
+                res[i] = check_cycle(us.data() + at, vs.data() + at, checks[i].proofsize);
+                at += checks[i].proofsize;
+            }
+            return res;
+        }
+    }
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#include "bitcash/miner/governor.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace bitcash
+{
+    namespace miner
+    {
+        namespace
+        {
+            const char* CGROUP_PATH = "/sys/fs/cgroup";
+
+            // share of the detected memory handed to the solvers, the rest is
+            // left for the stratum client, the stacks and the page cache
+            const double BUDGET_SHARE = 0.9;
+
+            bool read_number(const std::string& path, uint64_t& n)
+            {
+                std::ifstream f{path};
+                return f && f >> n;
+            }
+
+            // a parent limits its children, so the tightest limit on the path wins
+            void cgroup_limit(
+                    const std::string& root,
+                    std::string path,
+                    const char* max_file,
+                    const char* current_file,
+                    MemoryLimits& limits)
+            {
+                while(true) {
+                    uint64_t max = 0;
+                    uint64_t current = 0;
+                    const auto dir = root + (path == "/" ? "" : path) + "/";
+                    // memory.max reads "max" when unlimited and v1 reports a
+                    // huge number instead
+                    if(read_number(dir + max_file, max) && max < (1ULL << 60)) {
+                        read_number(dir + current_file, current);
+                        const uint64_t free = max - std::min(current, max);
+                        if(!limits.cgroup_limit || free < limits.cgroup_free) {
+                            limits.cgroup_limit = max;
+                            limits.cgroup_free = free;
+                        }
+                    }
+
+                    if(path.empty() || path == "/") {
+                        return;
+                    }
+                    const auto slash = path.rfind('/');
+                    path = slash == 0 ? "/" : path.substr(0, slash);
+                }
+            }
+        }
+
+        MemoryLimits read_memory_limits()
+        {
+            MemoryLimits limits;
+
+            std::ifstream meminfo{"/proc/meminfo"};
+            std::string line;
+            while(std::getline(meminfo, line)) {
+                std::stringstream s{line};
+                std::string key;
+                uint64_t kb = 0;
+                if(s >> key >> kb && key == "MemAvailable:") {
+                    limits.available = kb * 1024;
+                    break;
+                }
+            }
+
+            // lines are hierarchy-id:controllers:path, the v2 one is 0::path
+            std::ifstream cgroup{"/proc/self/cgroup"};
+            while(std::getline(cgroup, line)) {
+                const auto first = line.find(':');
+                const auto second = line.find(':', first + 1);
+                if(first == std::string::npos || second == std::string::npos) {
+                    continue;
+                }
+
+                const auto controllers = line.substr(first + 1, second - first - 1);
+                const auto path = line.substr(second + 1);
+                if(controllers.empty()) {
+                    cgroup_limit(CGROUP_PATH, path, "memory.max", "memory.current", limits);
+                } else if(controllers == "memory") {
+                    cgroup_limit(std::string{CGROUP_PATH} + "/memory", path,
+                            "memory.limit_in_bytes", "memory.usage_in_bytes", limits);
+                }
+            }
+
+            return limits;
+        }
+
+        Governor::Governor(uint64_t limit) :
+            _limits{read_memory_limits()}
+        {
+            if(limit) {
+                _budget = limit;
+                return;
+            }
+
+            uint64_t detected = std::numeric_limits<uint64_t>::max();
+            if(_limits.available) {
+                detected = _limits.available;
+            }
+            if(_limits.cgroup_limit) {
+                detected = std::min(detected, _limits.cgroup_free);
+            }
+            _budget = detected == std::numeric_limits<uint64_t>::max() ?
+                detected : static_cast<uint64_t>(detected * BUDGET_SHARE);
+        }
+
+        bool Governor::acquire(int worker, uint8_t edgebits, size_t threads, cuckoo::SolverOptions& options)
+        {
+            std::lock_guard<std::mutex> guard{_mutex};
+            _grants.erase(worker);
+
+            uint64_t reserved = 0;
+            for(const auto& g : _grants) {
+                reserved += g.second.bytes;
+            }
+            const uint64_t free = _budget - std::min(reserved, _budget);
+
+            // cheapest last, each step gives up speed for memory
+            std::vector<cuckoo::SolverOptions> candidates{options};
+            if(options.pipeline) {
+                candidates.push_back(options);
+                candidates.back().pipeline = false;
+            }
+            if(options.engine != cuckoo::Engine::Lean) {
+                candidates.push_back(options);
+                candidates.back().pipeline = false;
+                candidates.back().engine = cuckoo::Engine::Lean;
+            }
+
+            for(size_t i = 0; i < candidates.size(); i++) {
+                const uint64_t bytes = cuckoo::SolverBytes(edgebits, threads, candidates[i]);
+                if(bytes <= free) {
+                    options = candidates[i];
+                    _grants[worker] = Grant{bytes, i > 0};
+                    _waiting.erase(worker);
+                    return true;
+                }
+            }
+
+            _waiting.insert(worker);
+            return false;
+        }
+
+        void Governor::release(int worker)
+        {
+            std::lock_guard<std::mutex> guard{_mutex};
+            _grants.erase(worker);
+            _waiting.erase(worker);
+        }
+
+        const MemoryLimits& Governor::limits() const
+        {
+            return _limits;
+        }
+
+        uint64_t Governor::budget() const
+        {
+            return _budget;
+        }
+
+        uint64_t Governor::reserved() const
+        {
+            std::lock_guard<std::mutex> guard{_mutex};
+            uint64_t reserved = 0;
+            for(const auto& g : _grants) {
+                reserved += g.second.bytes;
+            }
+            return reserved;
+        }
+
+        std::vector<int> Governor::downgraded() const
+        {
+            std::lock_guard<std::mutex> guard{_mutex};
+            std::vector<int> res;
+            for(const auto& g : _grants) {
+                if(g.second.downgraded) {
+                    res.push_back(g.first);
+                }
+            }
+            return res;
+        }
+
+        std::vector<int> Governor::waiting() const
+        {
+            std::lock_guard<std::mutex> guard{_mutex};
+            return {_waiting.begin(), _waiting.end()};
+        }
+    }
+}
@@ -31,16 +31,16 @@
  */
 #include "bitcash/miner/miner.hpp"
 #include "bitcash/cuckoo/mean_cuckoo.h"
+#include "bitcash/cuckoo/verify.h"
 #include "bitcash/crypto/siphash.h"
 #include "bitcash/blake2/blake2.h"
 #include "bitcash/termcolor/termcolor.hpp"
 
 #include <chrono>
 #include <iostream>
-#include <set>
 
 
-using Cycle = std::set<uint32_t>;
+using Cycle = bitcash::util::Proof;
 using Cycles = std::vector<Cycle>;
 
 #ifdef CUDA_ENABLED
@@ -170,20 +170,58 @@ namespace bitcash
                 int workers,
                 int threads_per_worker,
                 const std::vector<int>& gpu_devices,
-                util::SubmitWorkFunc submit_work) :
+                util::SubmitWorkFunc submit_work,
+                const MinerOptions& options) :
             _submit_work{submit_work},
-            _pool{static_cast<int>((workers * threads_per_worker) + workers + gpu_devices.size())}
+            _pool{static_cast<int>((options.numa ? 0 : workers * threads_per_worker) + workers + gpu_devices.size())},
+            _governor{options.memory_limit}
         {
             assert(workers >= 0);
             assert(threads_per_worker >= 0);
 
             _state = NotRunning;
+            _epoch = 0;
             std::cout << "info :: workers: " << termcolor::cyan << workers << termcolor::reset << std::endl;
             std::cout << "info :: threads per worker: " << termcolor::cyan << threads_per_worker << termcolor::reset << std::endl;
             std::cout << "info :: gpu devices: " << termcolor::cyan << gpu_devices.size() << termcolor::reset << std::endl;
+            std::cout << "info :: cpu solver isa: " << termcolor::cyan << cuckoo::to_string(cuckoo::BestIsa()) << termcolor::reset << std::endl;
+            if(options.pipeline) {
+                std::cout << "info :: cpu solver: " << termcolor::cyan << "pipelined" << termcolor::reset << std::endl;
+            }
+
+            const auto& limits = _governor.limits();
+            std::cout << "info :: cpu solver memory budget: " << termcolor::cyan << (_governor.budget() >> 20) << "MB" << termcolor::reset;
+            if(limits.cgroup_limit) {
+                std::cout << " cgroup limit: " << termcolor::cyan << (limits.cgroup_limit >> 20) << "MB" << termcolor::reset;
+            }
+            std::cout << std::endl;
+
+            if(options.numa) {
+                _nodes = util::numa_nodes();
+                std::cout << "info :: numa nodes: " << termcolor::cyan << _nodes.size() << termcolor::reset << std::endl;
+            }
 
             for(int i = 0; i < workers; i++) {
-                _workers.emplace_back(i, threads_per_worker, false, _pool, *this);
+                const auto engine = options.engines.empty() ? cuckoo::Engine::Mean :
+                    cuckoo::ParseEngine(options.engines[std::min<size_t>(i, options.engines.size() - 1)]);
+                // the lean engine keeps no second arena to pipeline with
+                const bool pipeline = options.pipeline && engine == cuckoo::Engine::Mean;
+
+                if(!options.numa) {
+                    _workers.emplace_back(i, threads_per_worker, false, _pool, *this, -1, std::vector<int>{}, pipeline, engine);
+                    continue;
+                }
+
+                // every worker gets a thread team of its own pinned to the node
+                const auto& node = _nodes[i % _nodes.size()];
+                _worker_pools.push_back(std::make_unique<ctpl::thread_pool>(threads_per_worker));
+                auto& pool = *_worker_pools.back();
+                for(int t = 0; t < pool.size(); t++) {
+                    util::pin_thread(pool.get_thread(t), node.cpus);
+                }
+
+                std::cout << "info :: worker " << i << " on numa node: " << termcolor::cyan << node.id << termcolor::reset << std::endl;
+                _workers.emplace_back(i, threads_per_worker, false, pool, *this, node.id, node.cpus, pipeline, engine);
             }
 
             for(int i = 0; i < gpu_devices.size(); i++) {
@@ -209,6 +247,11 @@ namespace bitcash
                 _next_work = w;
             }
 
+            // graphs of the old job are worthless now, abandon them
+            if(j.clean) {
+                _epoch++;
+            }
+
             {
                 std::lock_guard<std::mutex> sguard{_stat_mutex};
                 if(_total_stats.start == std::chrono::high_resolution_clock::time_point{}) {
@@ -245,6 +288,11 @@ namespace bitcash
             }
         }
 
+        const std::atomic<uint64_t>& Miner::epoch() const
+        {
+            return _epoch;
+        }
+
         void Miner::clear_job() {
             _next_work.reset();
         }
@@ -290,6 +338,7 @@ namespace bitcash
         {
             std::cout << "info :: " << "stopping workers..." << std::endl;
             _state = Stopping;
+            _epoch++;
         }
 
         util::MaybeWork Miner::next_work() const
@@ -298,6 +347,16 @@ namespace bitcash
             return _next_work;
         }
 
+        Governor& Miner::governor()
+        {
+            return _governor;
+        }
+
+        const Governor& Miner::governor() const
+        {
+            return _governor;
+        }
+
         int Miner::total_workers() const
         {
             return _workers.size();
@@ -339,18 +398,39 @@ namespace bitcash
             return _current_stat;
         }
 
+        std::vector<std::pair<int, cuckoo::SolverStats>> Miner::solver_stats() const
+        {
+            std::vector<std::pair<int, cuckoo::SolverStats>> res;
+            for(const auto& worker : _workers) {
+                cuckoo::SolverStats stats;
+                if(worker.solver_stats(stats)) {
+                    res.emplace_back(worker.id(), stats);
+                }
+            }
+            return res;
+        }
+
         Worker::Worker(
                 int id,
                 int threads,
                 bool gpu_device,
                 ctpl::thread_pool& pool,
-                Miner& miner) :
+                Miner& miner,
+                int node,
+                const std::vector<int>& cpus,
+                bool pipeline,
+                cuckoo::Engine engine) :
             _state{NotRunning},
             _id{id},
             _threads{threads},
             _gpu_device{gpu_device},
             _pool{pool},
-            _miner{miner}
+            _miner{miner},
+            _node{node},
+            _cpus{cpus},
+            _pipeline{pipeline},
+            _engine{engine},
+            _waiting{false}
         {
         }
 
@@ -359,17 +439,72 @@ namespace bitcash
             _threads{o._threads},
             _gpu_device{o._gpu_device},
             _pool{o._pool},
-            _miner{o._miner}
+            _miner{o._miner},
+            _node{o._node},
+            _cpus{o._cpus},
+            _pipeline{o._pipeline},
+            _engine{o._engine},
+            _waiting{o._waiting}
         {
             State s = o._state;
             _state = s;
         }
 
-        int Worker::id()
+        Worker::~Worker()
+        {
+        }
+
+        int Worker::id() const
         {
             return _id;
         }
 
+        cuckoo::Solver* Worker::solver(uint8_t edgebits)
+        {
+            if(!_solver || _solver->edgebits() != edgebits || _solver->threads() != static_cast<size_t>(_threads)) {
+                std::lock_guard<std::mutex> guard{_solver_mutex};
+                _solver.reset();
+                _pending = boost::none;
+
+                cuckoo::SolverOptions options;
+                options.numa_node = _node;
+                options.pipeline = _pipeline;
+                options.engine = _engine;
+                options.epoch = &_miner.epoch();
+                if(!_miner.governor().acquire(_id, edgebits, _threads, options)) {
+                    if(!_waiting) {
+                        std::cerr << termcolor::yellow << "warning: " << "(" << _id << ") waiting for memory, a solver for edgebits "
+                                  << static_cast<int>(edgebits) << " does not fit what is left of the "
+                                  << (_miner.governor().budget() >> 20) << "MB budget" << termcolor::reset << std::endl;
+                    }
+                    _waiting = true;
+                    return nullptr;
+                }
+                _waiting = false;
+                _solver = std::make_unique<cuckoo::Solver>(edgebits, _threads, _pool, options);
+
+                const auto& stats = _solver->stats();
+                const bool downgraded = options.pipeline != _pipeline || options.engine != _engine;
+                std::cout << "info :: " << "(" << _id << ") solver " << cuckoo::to_string(stats.engine)
+                          << " isa: " << termcolor::cyan << cuckoo::to_string(stats.isa) << termcolor::reset << " memory: " << termcolor::cyan
+                          << (stats.memory_bytes >> 20) << "MB" << termcolor::reset
+                          << " on " << termcolor::cyan << util::to_string(stats.backing) << termcolor::reset
+                          << (stats.pipeline ? " pipelined" : "")
+                          << (downgraded ? " (downgraded to fit the memory budget)" : "") << std::endl;
+            }
+            return _solver.get();
+        }
+
+        bool Worker::solver_stats(cuckoo::SolverStats& stats) const
+        {
+            std::lock_guard<std::mutex> guard{_solver_mutex};
+            if(!_solver) {
+                return false;
+            }
+            stats = _solver->stats();
+            return true;
+        }
+
         bool target_test(
                 const std::array<uint32_t, 8>& hash,
                 const std::array<uint32_t, 8>& target)
@@ -388,6 +523,10 @@ namespace bitcash
         void Worker::run()
         {
             std::cout << "info :: " << "started worker: " << _id << std::endl;
+            if(_node >= 0 && !util::pin_current_thread(_cpus)) {
+                std::cerr << termcolor::yellow << "warning: " << "could not pin worker " << _id << " to numa node " << _node << termcolor::reset << std::endl;
+            }
+
             using namespace std::chrono_literals;
             util::Work prev_work;
             uint32_t n =  0xffffffffU / _miner.total_workers() * _id;
@@ -440,17 +579,43 @@ namespace bitcash
 
                 transform(hex_header_hash.begin(), hex_header_hash.end(), hex_header_hash.begin(), ::tolower); 
 
+                // the governor may hold the cpu solver back until memory frees up
+                cuckoo::Solver* s = nullptr;
+                if(!_gpu_device) {
+                    s = solver(edgebits);
+                    if(!s) {
+                        std::this_thread::sleep_for(100ms);
+                        continue;
+                    }
+                }
+
+                if(s && s->stats().pipeline) {
+                    bool found = s->solve_next(
+                            hex_header_hash.data(),
+                            hex_header_hash.size(),
+                            CUCKOO_PROOF_SIZE,
+                            cycles);
+
+                    // the cycles found belong to the graph started on the previous round
+                    auto done = std::move(_pending);
+                    _pending = PendingGraph{*work, hex_header_hash};
+                    if(done && !s->cancelled()) {
+                        process(done->work, done->hex_header_hash, found, cycles);
+                    }
+                    continue;
+                }
+
 #if CUDA_ENABLED
                 bool found = false;
                 if(!_gpu_device) {
-                    found = cuckoo::FindCycles(
+                    found = s->solve(
                             hex_header_hash.data(),
                             hex_header_hash.size(),
-                            edgebits,
                             CUCKOO_PROOF_SIZE,
-                            cycles,
-                            _threads,
-                            _pool);
+                            cycles);
+                    if(s->cancelled()) {
+                        continue;
+                    }
                 } else {
                     crypto::siphash_keys keys;
                     char hdrkey[32];
@@ -469,71 +634,90 @@ namespace bitcash
                             _id);
                 }
 #else
-                bool found = cuckoo::FindCycles(
+                bool found = s->solve(
                         hex_header_hash.data(),
                         hex_header_hash.size(),
-                        edgebits,
                         CUCKOO_PROOF_SIZE,
-                        cycles,
-                        _threads,
-                        _pool);
-#endif
-
-                auto& stat = _miner.current_stat();
-                stat.attempts++;
+                        cycles);
 
-                if(found) {
-                    stat.cycles+=cycles.size();
-
-                    int idx = 0;
-                    for(const auto& cycle: cycles) {
-                        assert(cycle.size() == work->cycle.size());
-                        assert(work->cycle.size() == CUCKOO_PROOF_SIZE);
-
-                        std::copy(cycle.begin(), cycle.end(), work->cycle.begin());
-
-                        std::array<uint32_t, 8> cycle_hash;
-                        std::array<uint8_t, 1 + sizeof(uint32_t) * CUCKOO_PROOF_SIZE> cycle_with_size;
-                        cycle_with_size[0] = CUCKOO_PROOF_SIZE;
-                        std::copy(
-                                reinterpret_cast<const uint8_t*>(work->cycle.data()),
-                                reinterpret_cast<const uint8_t*>(work->cycle.data()) + sizeof(uint32_t) * work->cycle.size(),
-                                cycle_with_size.begin()+1);
-
-                        util::double_sha256(
-                                reinterpret_cast<unsigned char*>(cycle_hash.data()),
-                                cycle_with_size.data(),
-                                cycle_with_size.size());
+                // a clean job came in mid graph, move on to it
+                if(s->cancelled()) {
+                    continue;
+                }
+#endif
 
-                        std::string cycle_hash_hex;
-                        util::to_hex(cycle_with_size, cycle_hash_hex);
+                process(*work, hex_header_hash, found, cycles);
+            }
+            _state = NotRunning;
+            std::cout << "info :: " << "worker " << _id << " stopped..." << std::endl;
+        }
 
-                        if(target_test(cycle_hash, work->target)) {
+        void Worker::process(util::Work& work, const std::string& hex_header_hash, bool found, const Cycles& cycles)
+        {
+            auto& stat = _miner.current_stat();
+            stat.attempts++;
+
+            if(found) {
+                stat.cycles+=cycles.size();
+
+                int idx = 0;
+                for(const auto& cycle: cycles) {
+                    assert(cycle.size() == CUCKOO_PROOF_SIZE);
+
+                    work.cycle = cycle;
+
+                    std::array<uint32_t, 8> cycle_hash;
+                    std::array<uint8_t, 1 + sizeof(uint32_t) * CUCKOO_PROOF_SIZE> cycle_with_size;
+                    cycle_with_size[0] = CUCKOO_PROOF_SIZE;
+                    std::copy(
+                            reinterpret_cast<const uint8_t*>(work.cycle.data()),
+                            reinterpret_cast<const uint8_t*>(work.cycle.data()) + sizeof(uint32_t) * work.cycle.size(),
+                            cycle_with_size.begin()+1);
+
+                    util::double_sha256(
+                            reinterpret_cast<unsigned char*>(cycle_hash.data()),
+                            cycle_with_size.data(),
+                            cycle_with_size.size());
+
+                    std::string cycle_hash_hex;
+                    util::to_hex(cycle_with_size, cycle_hash_hex);
+
+                    if(target_test(cycle_hash, work.target)) {
+                        // a bad share costs the pool's trust, check it before it leaves
+                        const auto status = cuckoo::VerifyProof(
+                                hex_header_hash.data(),
+                                hex_header_hash.size(),
+                                work.data[20] >> 24,
+                                CUCKOO_PROOF_SIZE,
+                                cycle);
+                        if(status != cuckoo::ProofStatus::Ok) {
+                            std::cerr << termcolor::red << "error: " << "(" << _id << ") dropping share (" << idx << "), "
+                                      << cuckoo::to_string(status) << termcolor::reset << std::endl;
+                            idx++;
+                            continue;
+                        }
 
 std::cout << "HASH: " << hex_header_hash << std::endl;
 
 std::cout << "data: ";
-                auto bwork = work->data;
-                for(int i = 0; i < 21; i++) {
-//                    be32enc(&bwork[i], work->data[i]);
-
-                   std::cout << std::hex << std::setfill('0') << std::setw(8) << bwork[i] << " ";
-                }
-    std::cout << std::endl;
+            auto bwork = work.data;
+            for(int i = 0; i < 21; i++) {
+//                    be32enc(&bwork[i], work.data[i]);
 
-                            std::cout << "info :: " << termcolor::green << "(" << _id << ") found share (" << idx << "): " << cycle_hash_hex << termcolor::reset << std::endl;
-                            stat.shares++;
-                            _miner.submit_work(*work);
-                        } else {
-                            std::cout << "info :: " << termcolor::blue << "(" << _id << ") found cycle (" << idx << "): " << cycle_hash_hex << termcolor::reset << std::endl;
-                        }
+               std::cout << std::hex << std::setfill('0') << std::setw(8) << bwork[i] << " ";
+            }
+std::cout << std::endl;
 
-                        idx++;
+                        std::cout << "info :: " << termcolor::green << "(" << _id << ") found share (" << idx << "): " << cycle_hash_hex << termcolor::reset << std::endl;
+                        stat.shares++;
+                        _miner.submit_work(work);
+                    } else {
+                        std::cout << "info :: " << termcolor::blue << "(" << _id << ") found cycle (" << idx << "): " << cycle_hash_hex << termcolor::reset << std::endl;
                     }
+
+                    idx++;
                 }
             }
-            _state = NotRunning;
-            std::cout << "info :: " << "worker " << _id << " stopped..." << std::endl;
         }
     }
 }
@@ -61,6 +61,7 @@ int main(int argc, char** argv)
     std::deque<std::string> reserve_pools_url_deq;
     std::vector<int> gpu_devices;
     std::string address;
+    std::vector<std::string> engines;
     desc.add_options()
         ("help,h", "show the help message")
         ("infogpu,i", "show the info about GPU in your system")
@@ -68,7 +69,11 @@ int main(int argc, char** argv)
         ("reserveurl,r", po::value<std::vector<std::string>>(&all_pools_url)->multitoken(), "Reserved pools url")
         ("address,a", po::value<std::string>(&address), "The address to send mining rewards to.")
         ("gpu,g", po::value<std::vector<int>>(&gpu_devices)->multitoken(), "Index of GPU device to use in mining(can use multiple times). For more info check --infogpu")
-        ("cores,c", po::value<int>()->default_value(bitcash::number_of_cores()), "The number of CPU cores to use.");
+        ("cores,c", po::value<int>()->default_value(bitcash::number_of_cores()), "The number of CPU cores to use.")
+        ("numa", "Bind each CPU worker and its memory to one NUMA node.")
+        ("pipeline", "Trim the next graph while searching the previous one, uses twice the memory.")
+        ("engine", po::value<std::vector<std::string>>(&engines)->multitoken(), "Solver engine of each CPU worker, mean or lean. Lean needs a fraction of the memory but is slower. The last one given applies to the remaining workers.")
+        ("memory-limit", po::value<uint64_t>()->default_value(0), "MB the CPU solvers may use, 0 to derive it from the available memory and the cgroup limit.");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -127,7 +132,13 @@ int main(int argc, char** argv)
     }
     
     bitcash::run_stratum(c.get());
-    bitcash::run_miner(c.get(), utilization.first ,utilization.second, gpu_devices);
+    bitcash::MinerOptions options;
+    options.numa = vm.count("numa") > 0;
+    options.pipeline = vm.count("pipeline") > 0;
+    options.engines = engines;
+    options.memory_limit = vm["memory-limit"].as<uint64_t>() << 20;
+
+    bitcash::run_miner(c.get(), utilization.first ,utilization.second, gpu_devices, options);
 
     int prev_graphs = 0;
     while(true) { 
@@ -32,6 +32,7 @@
 #include "bitcash/miner.hpp"
 #include "bitcash/stratum/stratum.hpp"
 #include "bitcash/miner/miner.hpp"
+#include "bitcash/cuckoo/mean_cuckoo.h"
 #include "bitcash/termcolor/termcolor.hpp"
 
 #include <iostream>
@@ -183,7 +184,12 @@ namespace bitcash
         c->stratum.stop();
     }
 
-    bool run_miner(Context* c, int workers, int threads_per_worker, const std::vector<int>& gpu_devices)
+    bool run_miner(
+            Context* c,
+            int workers,
+            int threads_per_worker,
+            const std::vector<int>& gpu_devices,
+            const MinerOptions& options)
     try
     {
         assert(c);
@@ -201,7 +207,8 @@ namespace bitcash
                 workers,
                 threads_per_worker,
                 gpu_devices,
-                c->submit_work_func);
+                c->submit_work_func,
+                options);
 
         std::cout << "info :: " << "starting miner..."<< std::endl; 
         if(c->mining_thread.joinable()) {
@@ -312,6 +319,18 @@ namespace bitcash
         };
     }
 
+    SolverStat to_public_stat(int worker, const cuckoo::SolverStats& s)
+    {
+        return {
+            worker,
+            cuckoo::to_string(s.engine),
+            cuckoo::to_string(s.isa),
+            util::to_string(s.backing),
+            s.memory_bytes,
+            s.pipeline
+        };
+    }
+
     MinerStats get_miner_stats(Context* c)
     {
         assert(c);
@@ -330,7 +349,21 @@ namespace bitcash
                 history.begin(),
                 history.end(),
                 s.history.begin(),
-                to_public_stat);
+                [](const miner::Stat& s) { return to_public_stat(s); });
+
+        for(const auto& solver : c->miner->solver_stats()) {
+            s.solvers.push_back(to_public_stat(solver.first, solver.second));
+        }
+
+        const auto& governor = c->miner->governor();
+        s.memory = {
+            governor.budget(),
+            governor.limits().available,
+            governor.limits().cgroup_limit,
+            governor.reserved(),
+            governor.downgraded(),
+            governor.waiting()
+        };
 
         return s;
     }
@@ -339,6 +372,57 @@ namespace bitcash
         return miner::GPUInfo();
     };
 
+    struct Solver
+    {
+        Solver(int edgebits, int threads, const cuckoo::SolverOptions& options) :
+            pool{threads},
+            solver{static_cast<uint8_t>(edgebits), static_cast<size_t>(threads), pool, options} {}
+
+        ctpl::thread_pool pool;
+        cuckoo::Solver solver;
+    };
+
+    Solver* create_solver(int edgebits, int threads, const std::string& engine)
+    try
+    {
+        assert(threads > 0);
+        cuckoo::SolverOptions options;
+        options.engine = cuckoo::ParseEngine(engine);
+        return new Solver{edgebits, threads, options};
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << termcolor::red << "error: " << "error creating solver: " << e.what() << termcolor::reset << std::endl;
+        return nullptr;
+    }
+
+    void delete_solver(Solver* s)
+    {
+        if(s) { delete s;}
+    }
+
+    bool solve_header(Solver* s, const std::string& hex_header_hash, std::vector<Cycle>& cycles)
+    {
+        assert(s);
+        const int CUCKOO_PROOF_SIZE = 42;
+
+        cuckoo::Cycles found;
+        if(!s->solver.solve(hex_header_hash.data(), hex_header_hash.size(), CUCKOO_PROOF_SIZE, found)) {
+            return false;
+        }
+
+        for(const auto& cycle : found) {
+            cycles.emplace_back(cycle.begin(), cycle.end());
+        }
+        return true;
+    }
+
+    SolverStat get_solver_stats(Solver* s)
+    {
+        assert(s);
+        return to_public_stat(-1, s->solver.stats());
+    }
+
 
 }
 
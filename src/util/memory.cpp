@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#include "bitcash/util/memory.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+namespace bitcash
+{
+    namespace util
+    {
+        namespace
+        {
+            const size_t PAGE_4K = 4096;
+            const size_t PAGE_2M = 2 * 1024 * 1024;
+            const size_t PAGE_1G = 1024 * 1024 * 1024;
+
+            size_t round_up(size_t n, size_t page)
+            {
+                return (n + page - 1) / page * page;
+            }
+
+            // huge page mappings must be whole pages, everything else is
+            // rounded to 2MB so transparent huge pages can cover it
+            size_t mapped_size(size_t bytes, PageBacking backing)
+            {
+                return round_up(bytes, backing == PageBacking::Huge1G ? PAGE_1G : PAGE_2M);
+            }
+
+#if defined(__unix__) || defined(__APPLE__)
+            void* map(size_t bytes, int flags)
+            {
+                void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+                return p == MAP_FAILED ? nullptr : p;
+            }
+#endif
+
+            // prefer allocating the pages of the range on node, done with the
+            // raw syscall to avoid depending on libnuma
+            void bind(void* p, size_t bytes, int node)
+            {
+#if defined(__linux__) && defined(SYS_mbind)
+                const int MPOL_PREFERRED = 1;
+                const unsigned long BITS = 8 * sizeof(unsigned long);
+                if(node < 0 || node >= 64 * static_cast<int>(BITS)) {
+                    return;
+                }
+
+                unsigned long mask[64] = {0};
+                mask[node / BITS] = 1UL << (node % BITS);
+                syscall(SYS_mbind, p, bytes, MPOL_PREFERRED, mask, 64 * BITS, 0);
+#endif
+            }
+        }
+
+        const char* to_string(PageBacking backing)
+        {
+            switch(backing) {
+                case PageBacking::Huge1G: return "1GB huge pages";
+                case PageBacking::Huge2M: return "2MB huge pages";
+                case PageBacking::Transparent: return "transparent huge pages";
+                default: return "normal pages";
+            }
+        }
+
+        void* alloc_large(size_t bytes, PageBacking& backing, int node)
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            void* p = nullptr;
+#ifdef MAP_HUGETLB
+            if(bytes >= PAGE_1G) {
+                p = map(mapped_size(bytes, PageBacking::Huge1G), MAP_HUGETLB | (30 << MAP_HUGE_SHIFT));
+                if(p) {
+                    backing = PageBacking::Huge1G;
+                    bind(p, mapped_size(bytes, backing), node);
+                    return p;
+                }
+            }
+
+            if(bytes >= PAGE_2M) {
+                p = map(mapped_size(bytes, PageBacking::Huge2M), MAP_HUGETLB | (21 << MAP_HUGE_SHIFT));
+                if(p) {
+                    backing = PageBacking::Huge2M;
+                    bind(p, mapped_size(bytes, backing), node);
+                    return p;
+                }
+            }
+#endif
+
+            p = map(mapped_size(bytes, PageBacking::Normal), 0);
+            if(!p) {
+                throw std::bad_alloc{};
+            }
+
+            backing = PageBacking::Normal;
+#ifdef MADV_HUGEPAGE
+            if(bytes >= PAGE_2M && madvise(p, mapped_size(bytes, PageBacking::Normal), MADV_HUGEPAGE) == 0) {
+                backing = PageBacking::Transparent;
+            }
+#endif
+            bind(p, mapped_size(bytes, PageBacking::Normal), node);
+            return p;
+#else
+            backing = PageBacking::Normal;
+            void* p = std::malloc(bytes);
+            if(!p) {
+                throw std::bad_alloc{};
+            }
+            return p;
+#endif
+        }
+
+        void free_large(void* p, size_t bytes, PageBacking backing)
+        {
+            if(!p) {
+                return;
+            }
+#if defined(__unix__) || defined(__APPLE__)
+            munmap(p, mapped_size(bytes, backing));
+#else
+            std::free(p);
+#endif
+        }
+
+        void prefault(void* p, size_t bytes)
+        {
+            if(!bytes) {
+                return;
+            }
+#if defined(__linux__)
+            // populate the range in one call when the kernel supports it (5.14+)
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(p) / PAGE_4K * PAGE_4K;
+            const uintptr_t end = reinterpret_cast<uintptr_t>(p) + bytes;
+            if(madvise(reinterpret_cast<void*>(begin), end - begin, MADV_POPULATE_WRITE) == 0) {
+                return;
+            }
+#endif
+            uint8_t* b = static_cast<uint8_t*>(p);
+            for(size_t i = 0; i < bytes; i += PAGE_4K) {
+                b[i] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2018 The Merit Foundation
+ * Copyright (C) 2018 The BitCash developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either vedit_refsion 3 of the License, or
+ * (at your option) any later vedit_refsion.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * Botan library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than Botan. If you modify file(s) with
+ * this exception, you may extend this exception to your version of the
+ * file(s), but you are not obligated to do so. If you do not wish to do
+ * so, delete this exception statement from your version. If you delete
+ * this exception statement from all source files in the program, then
+ * also delete it here.
+ */
+#include "bitcash/util/topology.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace bitcash
+{
+    namespace util
+    {
+        namespace
+        {
+            const char* NODE_PATH = "/sys/devices/system/node";
+
+            bool read_line(const std::string& path, std::string& line)
+            {
+                std::ifstream f{path};
+                return f && std::getline(f, line);
+            }
+
+#if defined(__linux__)
+            bool pin(pthread_t t, const std::vector<int>& cpus)
+            {
+                if(cpus.empty()) {
+                    return false;
+                }
+
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for(int cpu : cpus) {
+                    if(cpu >= 0 && cpu < CPU_SETSIZE) {
+                        CPU_SET(cpu, &set);
+                    }
+                }
+                return pthread_setaffinity_np(t, sizeof(set), &set) == 0;
+            }
+#endif
+        }
+
+        std::vector<int> parse_cpu_list(const std::string& list)
+        {
+            std::vector<int> cpus;
+            std::stringstream s{list};
+            std::string range;
+            while(std::getline(s, range, ',')) {
+                if(range.empty() || range == "\n") {
+                    continue;
+                }
+
+                int first = 0;
+                int last = 0;
+                const auto dash = range.find('-');
+                try {
+                    first = std::stoi(range.substr(0, dash));
+                    last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                } catch(...) {
+                    continue;
+                }
+
+                for(int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        NumaNodes numa_nodes()
+        {
+            NumaNodes nodes;
+
+            std::string online;
+            if(read_line(std::string{NODE_PATH} + "/online", online)) {
+                for(int id : parse_cpu_list(online)) {
+                    std::string cpulist;
+                    if(!read_line(std::string{NODE_PATH} + "/node" + std::to_string(id) + "/cpulist", cpulist)) {
+                        continue;
+                    }
+
+                    auto cpus = parse_cpu_list(cpulist);
+                    if(!cpus.empty()) {
+                        nodes.push_back({id, cpus});
+                    }
+                }
+            }
+
+            if(nodes.empty()) {
+                NumaNode all{0, {}};
+                for(int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); cpu++) {
+                    all.cpus.push_back(cpu);
+                }
+                nodes.push_back(all);
+            }
+
+            return nodes;
+        }
+
+        bool pin_thread(std::thread& t, const std::vector<int>& cpus)
+        {
+#if defined(__linux__)
+            return pin(t.native_handle(), cpus);
+#else
+            return false;
+#endif
+        }
+
+        bool pin_current_thread(const std::vector<int>& cpus)
+        {
+#if defined(__linux__)
+            return pin(pthread_self(), cpus);
+#else
+            return false;
+#endif
+        }
+    }
+}